@@ -0,0 +1,124 @@
+/*!
+ * \file aes.c
+ * \brief Throughput of the AES backends in aes.c.
+ * 
+ * Built by `make bench`, which compiles aes.c with \ref AES_BITSLICE enabled.
+ * `bench_aes` uses the byte-wise cipher and `bench_aes_ttable` uses the T-table cipher.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "aes.h"
+
+/// Number of blocks encrypted by each measurement.
+#define BENCH_AES_BLOCKS (1UL << 20)
+
+/// Length of the buffer encrypted in counter mode.
+#define BENCH_AES_STREAM_LEN (1UL << 16)
+
+/// Length of the encrypted part of a Unifying keystroke.
+#define BENCH_AES_KEYSTROKE_LEN 8
+
+/*!
+ * Get a monotonic time.
+ * 
+ * \return  Time in nanoseconds.
+ */
+static uint64_t bench_time(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*!
+ * Print the time taken per block.
+ * 
+ * \param[in]   name    Name of the measurement.
+ * \param[in]   start   Time returned by bench_time() before the measurement.
+ * \param[in]   blocks  Number of blocks that were encrypted.
+ * \param[in]   check   Byte of the output, printed so that the work can't be optimized away.
+ */
+static void bench_report(const char* name, uint64_t start, uint64_t blocks, uint8_t check)
+{
+    double elapsed = (double) (bench_time() - start);
+
+    printf("%-32s %8.1f ns/block  (%02x)\n", name, elapsed / blocks, check);
+}
+
+int main(void)
+{
+    static uint8_t buffer[AES_BITSLICE_BLOCKS * AES_BLOCKLEN];
+    static uint8_t stream[BENCH_AES_STREAM_LEN];
+    const uint8_t iv[AES_BLOCKLEN] = {0};
+    const uint8_t key[AES_KEYLEN] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+    struct AES_ctx ctx;
+    struct AES_bitslice_ctx bitslice_ctx;
+    uint64_t start;
+
+    AES_init_ctx_iv(&ctx, key, iv);
+    AES_bitslice_init_ctx_iv(&bitslice_ctx, key, iv);
+
+#if defined(AES_TTABLE) && (AES_TTABLE == 1)
+    printf("cipher: T-table\n");
+#else
+    printf("cipher: byte-wise\n");
+#endif
+
+    start = bench_time();
+
+    for(unsigned long i = 0; i < BENCH_AES_BLOCKS; i++)
+    {
+        // Every keystroke uses a new IV with the prepared key, like unifying_encrypt_prepared().
+        buffer[AES_BLOCKLEN - 1] = (uint8_t) i;
+        AES_ctx_set_iv(&ctx, buffer);
+        AES_CTR_xcrypt_buffer(&ctx, stream, BENCH_AES_KEYSTROKE_LEN);
+    }
+
+    bench_report("Unifying keystroke (8-byte CTR)", start, BENCH_AES_BLOCKS, stream[0]);
+
+    AES_ctx_set_iv(&ctx, iv);
+    start = bench_time();
+
+    for(unsigned long i = 0; i < BENCH_AES_BLOCKS; i++)
+    {
+        AES_ECB_encrypt(&ctx, buffer);
+    }
+
+    bench_report("AES_ECB_encrypt", start, BENCH_AES_BLOCKS, buffer[0]);
+
+    start = bench_time();
+
+    for(unsigned long i = 0; i < BENCH_AES_BLOCKS; i += AES_BITSLICE_BLOCKS)
+    {
+        AES_bitslice_ECB_encrypt_blocks(&bitslice_ctx, buffer, AES_BITSLICE_BLOCKS);
+    }
+
+    bench_report("AES_bitslice_ECB_encrypt_blocks", start, BENCH_AES_BLOCKS, buffer[0]);
+
+    start = bench_time();
+
+    for(unsigned long i = 0; i < BENCH_AES_BLOCKS; i += BENCH_AES_STREAM_LEN / AES_BLOCKLEN)
+    {
+        AES_CTR_xcrypt_buffer(&ctx, stream, BENCH_AES_STREAM_LEN);
+    }
+
+    bench_report("AES_CTR_xcrypt_buffer", start, BENCH_AES_BLOCKS, stream[0]);
+
+    start = bench_time();
+
+    for(unsigned long i = 0; i < BENCH_AES_BLOCKS; i += BENCH_AES_STREAM_LEN / AES_BLOCKLEN)
+    {
+        AES_bitslice_CTR_xcrypt_buffer(&bitslice_ctx, stream, BENCH_AES_STREAM_LEN);
+    }
+
+    bench_report("AES_bitslice_CTR_xcrypt_buffer", start, BENCH_AES_BLOCKS, stream[0]);
+
+    return 0;
+}
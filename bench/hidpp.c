@@ -0,0 +1,157 @@
+/*!
+ * \file hidpp.c
+ * \brief Round trip time of HID++ queries with a simulated receiver.
+ * 
+ * The receiver hands each query to the device in the ACK payload of whatever the device transmits,
+ * and asks its next query as soon as the previous one has been answered.
+ * Every transmission takes 1 ms and the device sleeps until unifying_next_deadline() between ticks,
+ * so the times are in simulated milliseconds.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "unifying.h"
+
+/// Number of queries asked by the simulated receiver.
+#define BENCH_HIDPP_QUERIES 64
+
+/// Keep-alive timeout in milliseconds used by the device.
+#define BENCH_HIDPP_TIMEOUT 20
+
+static uint32_t bench_now;
+static uint8_t bench_ack[UNIFYING_HIDPP_1_0_SHORT_LEN];
+static bool bench_ack_ready;
+static uint32_t bench_asked;
+static uint32_t bench_answered;
+static uint32_t bench_asked_time;
+static uint32_t bench_total;
+static uint32_t bench_worst;
+
+/*!
+ * Queue the next query in the receiver's ACK payload.
+ */
+static void bench_ask(void)
+{
+    struct unifying_hidpp_1_0_short query;
+    uint8_t params[UNIFYING_HIDPP_1_0_SHORT_PARAMS_LEN] = {0};
+
+    // GET_REGISTER of an unknown register is answered with an error message, which is enough to time.
+    unifying_hidpp_1_0_short_init(&query, 0xFF, UNIFYING_HIDPP_1_0_SUB_ID_GET_REGISTER, params);
+    unifying_hidpp_1_0_short_pack(bench_ack, &query);
+    bench_ack_ready = true;
+    bench_asked++;
+}
+
+static uint8_t bench_transmit_payload(const uint8_t* payload, uint8_t length)
+{
+    bench_now++;
+
+    if(length == UNIFYING_HIDPP_1_0_SHORT_LEN && payload[1] == 0x50)
+    {
+        uint32_t round_trip = bench_now - bench_asked_time;
+
+        bench_total += round_trip;
+        bench_worst = round_trip > bench_worst ? round_trip : bench_worst;
+        bench_answered++;
+
+        if(bench_asked < BENCH_HIDPP_QUERIES)
+        {
+            // The next query rides on the ACK of this response.
+            bench_ask();
+            bench_asked_time = bench_now;
+        }
+    }
+
+    return 0;
+}
+
+static bool bench_payload_available(void)
+{
+    return bench_ack_ready;
+}
+
+static uint8_t bench_payload_size(void)
+{
+    return UNIFYING_HIDPP_1_0_SHORT_LEN;
+}
+
+static uint8_t bench_receive_payload(uint8_t* payload, uint8_t length)
+{
+    bench_ack_ready = false;
+    memcpy(payload, bench_ack, length);
+    return length;
+}
+
+static uint8_t bench_set_address(const uint8_t address[UNIFYING_ADDRESS_LEN])
+{
+    (void) address;
+    return 0;
+}
+
+static uint8_t bench_set_channel(uint8_t channel)
+{
+    (void) channel;
+    return 0;
+}
+
+static uint32_t bench_time(void)
+{
+    return bench_now;
+}
+
+int main(void)
+{
+    struct unifying_interface interface;
+    struct unifying_state state;
+    uint8_t address[UNIFYING_ADDRESS_LEN] = {0};
+    uint8_t aes_key[UNIFYING_AES_BLOCK_LEN] = {0};
+
+    unifying_interface_init(&interface,
+                            bench_transmit_payload,
+                            bench_receive_payload,
+                            bench_payload_available,
+                            bench_payload_size,
+                            bench_set_address,
+                            bench_set_channel,
+                            bench_time,
+                            NULL);
+    unifying_state_init(&state,
+                        &interface,
+                        unifying_ring_buffer_create(sizeof(struct unifying_transmit_entry), 8),
+                        unifying_ring_buffer_create(sizeof(struct unifying_receive_entry), 8),
+                        address,
+                        aes_key,
+                        0,
+                        BENCH_HIDPP_TIMEOUT,
+                        unifying_channels[0]);
+    unifying_state_idle_ladder_set(&state, NULL, 0);
+
+    // The first query is picked up by the ACK of the next keep-alive.
+    bench_ask();
+    bench_asked_time = bench_now;
+    uint32_t start = bench_now;
+
+    while(bench_answered < BENCH_HIDPP_QUERIES)
+    {
+        uint32_t deadline = unifying_next_deadline(&state);
+
+        if(!unifying_time_reached(bench_now, deadline))
+        {
+            bench_now = deadline;
+        }
+
+        unifying_tick(&state);
+    }
+
+    printf("%d queries in %u ms, round trip mean %.1f ms, worst %u ms\n",
+           BENCH_HIDPP_QUERIES,
+           bench_now - start,
+           (double) bench_total / bench_answered,
+           bench_worst);
+
+    unifying_ring_buffer_destroy(state.transmit_buffer);
+    unifying_ring_buffer_destroy(state.receive_buffer);
+    return 0;
+}
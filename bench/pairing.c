@@ -0,0 +1,280 @@
+/*!
+ * \file pairing.c
+ * \brief Time until the first pairing response with a simulated receiver.
+ * 
+ * The receiver listens on one of \ref unifying_pairing_channels and answers each pairing request
+ * in the ACK payload of the next payload it receives.
+ * Every pairing channel and a range of seeds are tried, once with a fresh state and once more
+ * pairing again with the same state, with part of the transmissions lost at random.
+ * A transmission takes 1 ms, or \ref BENCH_PAIRING_FAILURE_TIME if it failed,
+ * and the device sleeps until unifying_next_deadline() between ticks,
+ * so the times are in simulated milliseconds.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "unifying.h"
+
+/// Number of seeds tried on each pairing channel.
+#define BENCH_PAIRING_SEEDS 20
+
+/// Time in milliseconds that a failed transmission takes, including the radio's retransmissions.
+#define BENCH_PAIRING_FAILURE_TIME 4
+
+/// Keep-alive timeout in milliseconds used by the device.
+#define BENCH_PAIRING_TIMEOUT 20
+
+/// RF channel the device starts on.
+#define BENCH_PAIRING_START_CHANNEL 5
+
+static uint32_t bench_now;
+static uint32_t bench_random;
+static uint8_t bench_loss;
+static uint8_t bench_channel;
+static uint8_t bench_receiver_channel;
+static uint8_t bench_id;
+static uint8_t bench_pending;
+static uint8_t bench_ack[UNIFYING_MAX_PAYLOAD_LEN];
+static uint8_t bench_ack_length;
+static bool bench_ack_ready;
+static bool bench_responded;
+static uint32_t bench_first_response;
+
+/*!
+ * Get a pseudo-random number.
+ * 
+ * \return  A number from 0 to 32767.
+ */
+static uint32_t bench_rand(void)
+{
+    bench_random = bench_random * 1103515245 + 12345;
+    return (bench_random >> 16) & 0x7FFF;
+}
+
+/*!
+ * Prepare the receiver's response to a pairing request.
+ * 
+ * \param[in]   step    Step of the pairing request.
+ */
+static void bench_respond(uint8_t step)
+{
+    memset(bench_ack, 0, sizeof(bench_ack));
+
+    switch(step)
+    {
+    case 1:
+        bench_ack[0] = bench_id;
+        bench_ack[1] = 0x1F;
+        bench_ack[2] = 0x01;
+        bench_ack[3] = 0xA0;
+        bench_ack[4] = 0xB1;
+        bench_ack[5] = 0xC2;
+        bench_ack[6] = 0xD3;
+        bench_ack[7] = 0x07;
+        bench_ack[8] = 0x08;
+        bench_ack_length = UNIFYING_PAIR_RESPONSE_1_LEN;
+        break;
+    case 2:
+        bench_ack[1] = 0x1F;
+        bench_ack[2] = 0x02;
+        bench_ack[3] = 0x12;
+        bench_ack[4] = 0x34;
+        bench_ack[5] = 0x56;
+        bench_ack[6] = 0x78;
+        bench_ack_length = UNIFYING_PAIR_RESPONSE_2_LEN;
+        break;
+    default:
+        bench_ack[1] = 0x0F;
+        bench_ack[2] = 0x06;
+        bench_ack[3] = 0x01;
+        bench_ack_length = UNIFYING_PAIR_RESPONSE_3_LEN;
+        break;
+    }
+
+    bench_ack[bench_ack_length - 1] = unifying_checksum(bench_ack, bench_ack_length - 1);
+    bench_ack_ready = true;
+}
+
+static uint8_t bench_transmit_payload(const uint8_t* payload, uint8_t length)
+{
+    (void) length;
+
+    if(bench_channel != bench_receiver_channel || bench_rand() % 100 < bench_loss)
+    {
+        bench_now += BENCH_PAIRING_FAILURE_TIME;
+        return 1;
+    }
+
+    bench_now++;
+
+    if(payload[1] == 0x5F && payload[2] >= 1 && payload[2] <= 3)
+    {
+        if(payload[2] == 1)
+        {
+            bench_id = payload[0];
+        }
+
+        bench_pending = payload[2];
+    }
+    else if(bench_pending)
+    {
+        bench_respond(bench_pending);
+        bench_pending = 0;
+    }
+
+    return 0;
+}
+
+static bool bench_payload_available(void)
+{
+    return bench_ack_ready;
+}
+
+static uint8_t bench_payload_size(void)
+{
+    return bench_ack_length;
+}
+
+static uint8_t bench_receive_payload(uint8_t* payload, uint8_t length)
+{
+    if(!bench_responded)
+    {
+        bench_responded = true;
+        bench_first_response = bench_now;
+    }
+
+    bench_ack_ready = false;
+    memcpy(payload, bench_ack, length);
+    return length;
+}
+
+static uint8_t bench_set_address(const uint8_t address[UNIFYING_ADDRESS_LEN])
+{
+    (void) address;
+    return 0;
+}
+
+static uint8_t bench_set_channel(uint8_t channel)
+{
+    bench_channel = channel;
+    return 0;
+}
+
+static uint32_t bench_time(void)
+{
+    return bench_now;
+}
+
+/*!
+ * Pair once and wait until pairing has finished.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ * 
+ * \return  Time until the first pairing response was received,
+ *          or `UINT32_MAX` if no response was received.
+ */
+static uint32_t bench_pair(struct unifying_state* state)
+{
+    uint32_t start = bench_now;
+
+    bench_pending = 0;
+    bench_ack_ready = false;
+    bench_responded = false;
+
+    if(unifying_pair_start(state, 0x42, 0x1234, 0x0147, 0xCAFEBABE, 0x11223344, 0x1E40, "Keyboard", 8))
+    {
+        return UINT32_MAX;
+    }
+
+    while(unifying_pair_result(state) == UNIFYING_BUSY_ERROR)
+    {
+        uint32_t deadline = unifying_next_deadline(state);
+
+        if(!unifying_time_reached(bench_now, deadline))
+        {
+            bench_now = deadline;
+        }
+
+        unifying_tick(state);
+    }
+
+    return bench_responded ? bench_first_response - start : UINT32_MAX;
+}
+
+int main(void)
+{
+    struct unifying_interface interface;
+    struct unifying_state state;
+    uint8_t address[UNIFYING_ADDRESS_LEN] = {0};
+    uint8_t aes_key[UNIFYING_AES_BLOCK_LEN] = {0};
+
+    unifying_interface_init(&interface,
+                            bench_transmit_payload,
+                            bench_receive_payload,
+                            bench_payload_available,
+                            bench_payload_size,
+                            bench_set_address,
+                            bench_set_channel,
+                            bench_time,
+                            NULL);
+
+    for(bench_loss = 0; bench_loss <= 50; bench_loss += 25)
+    {
+        uint32_t found[2] = {0};
+        uint32_t total[2] = {0};
+        uint32_t worst[2] = {0};
+        uint32_t runs = 0;
+
+        for(uint8_t channel = 0; channel < UNIFYING_PAIRING_CHANNELS_LEN; channel++)
+        {
+            for(uint32_t seed = 0; seed < BENCH_PAIRING_SEEDS; seed++)
+            {
+                bench_receiver_channel = unifying_pairing_channels[channel];
+                bench_random = seed * 7919 + channel;
+                bench_channel = BENCH_PAIRING_START_CHANNEL;
+                unifying_state_init(&state,
+                                    &interface,
+                                    unifying_ring_buffer_create(sizeof(struct unifying_transmit_entry), 8),
+                                    unifying_ring_buffer_create(sizeof(struct unifying_receive_entry), 8),
+                                    address,
+                                    aes_key,
+                                    0,
+                                    BENCH_PAIRING_TIMEOUT,
+                                    BENCH_PAIRING_START_CHANNEL);
+                unifying_state_idle_ladder_set(&state, NULL, 0);
+
+                // The second pairing reuses what the first one learned about the receiver.
+                for(uint8_t repeat = 0; repeat < 2; repeat++)
+                {
+                    uint32_t elapsed = bench_pair(&state);
+
+                    if(elapsed != UINT32_MAX)
+                    {
+                        found[repeat]++;
+                        total[repeat] += elapsed;
+                        worst[repeat] = elapsed > worst[repeat] ? elapsed : worst[repeat];
+                    }
+                }
+
+                runs++;
+                unifying_ring_buffer_destroy(state.transmit_buffer);
+                unifying_ring_buffer_destroy(state.receive_buffer);
+            }
+        }
+
+        for(uint8_t repeat = 0; repeat < 2; repeat++)
+        {
+            printf("loss %2u%% %-6s: found %3u/%u, first response mean %5.1f ms, worst %4u ms\n",
+                   bench_loss,
+                   repeat ? "repeat" : "first",
+                   found[repeat],
+                   runs,
+                   found[repeat] ? (double) total[repeat] / found[repeat] : 0.0,
+                   worst[repeat]);
+        }
+    }
+
+    return 0;
+}
@@ -14,9 +14,12 @@
 
 #define TRANSMIT_BUFFER_SIZE 8
 #define RECEIVE_BUFFER_SIZE 8
-#define SLOW_TIMEOUT 110
 
-int eeprom_address;
+// Non-volatile memory layout.
+// Counter lease slots are written far more often than the state blob so they're kept apart.
+#define EEPROM_BLOB_ADDRESS 0
+#define EEPROM_LEASE_ADDRESS (EEPROM_BLOB_ADDRESS + UNIFYING_STATE_BLOB_LEN)
+
 uint8_t input_state;
 uint8_t address[UNIFYING_ADDRESS_LEN];
 uint8_t aes_key[UNIFYING_AES_BLOCK_LEN];
@@ -74,6 +77,20 @@ uint8_t set_channel(uint8_t channel) {
   return 0;
 }
 
+// Save connection details to non-volatile memory.
+void save_state() {
+  uint8_t blob[UNIFYING_STATE_BLOB_LEN];
+  unifying_state_blob_pack(&state, blob);
+  EEPROM.put(EEPROM_BLOB_ADDRESS, blob);
+}
+
+// Reserve more AES counter values before the current ones run out.
+void renew_counter_lease() {
+  uint8_t slot[UNIFYING_COUNTER_LEASE_SLOT_LEN];
+  uint8_t index = unifying_state_counter_lease_renew(&state, slot);
+  EEPROM.put(EEPROM_LEASE_ADDRESS + index * UNIFYING_COUNTER_LEASE_SLOT_LEN, slot);
+}
+
 // Check for key presses and send scancodes.
 void scan_keyboard_matrix() {
   uint8_t keys[UNIFYING_KEYS_LEN] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
@@ -99,7 +116,6 @@ void scan_keyboard_matrix() {
     keys[5] = 0x00;
     modifiers = 0x00;
     unifying_encrypted_keystroke(&state, keys, modifiers);
-    unifying_set_timeout(&state, SLOW_TIMEOUT);
   }
 }
 
@@ -154,15 +170,16 @@ void setup() {
                           millis,
                           NULL);
 
-  transmit_buffer = unifying_ring_buffer_create(TRANSMIT_BUFFER_SIZE);
-  receive_buffer = unifying_ring_buffer_create(RECEIVE_BUFFER_SIZE);
+  transmit_buffer = unifying_ring_buffer_create(sizeof(struct unifying_transmit_entry), TRANSMIT_BUFFER_SIZE);
+  receive_buffer = unifying_ring_buffer_create(sizeof(struct unifying_receive_entry), RECEIVE_BUFFER_SIZE);
 
-  // Load connection details to non-volatile memory.
-  eeprom_address = 0;
-  EEPROM.get(eeprom_address, address);
-  eeprom_address += sizeof(address);
-  EEPROM.get(eeprom_address, aes_key);
+  // Load connection details from non-volatile memory.
+  uint8_t blob[UNIFYING_STATE_BLOB_LEN];
+  struct unifying_link_snapshot snapshot;
+  EEPROM.get(EEPROM_BLOB_ADDRESS, blob);
+  bool stored = !unifying_state_blob_unpack(address, aes_key, &snapshot, blob);
 
+  // The stored counter lease replaces this unless nothing has been stored yet.
   uint32_t aes_counter = random();
 
   unifying_state_init(&state,
@@ -175,6 +192,16 @@ void setup() {
                       UNIFYING_DEFAULT_TIMEOUT_KEYBOARD,
                       unifying_channels[0]);
 
+  if(stored) {
+    // Start on the channel that worked last time.
+    unifying_state_link_restore(&state, &snapshot);
+  }
+
+  uint8_t slots[UNIFYING_COUNTER_LEASE_SLOTS][UNIFYING_COUNTER_LEASE_SLOT_LEN];
+  EEPROM.get(EEPROM_LEASE_ADDRESS, slots);
+  unifying_state_counter_lease_load(&state, slots);
+  renew_counter_lease();
+
 
   enum unifying_error err;
 
@@ -202,14 +229,6 @@ void setup() {
                         name,
                         name_length);
 
-    if(!err) {
-      // Pairing successful.
-      // Save connection details to non-volatile memory.
-      eeprom_address = 0;
-      EEPROM.put(eeprom_address, address);
-      eeprom_address += sizeof(address);
-      EEPROM.put(eeprom_address, aes_key);
-    }
   }
 
   Serial.println(unifying_get_error_name(err));
@@ -219,9 +238,17 @@ void setup() {
     err = unifying_connect(&state);
     delay(100);
   }
+
+  // Connected or paired successfully.
+  // EEPROM.put() only writes bytes that changed.
+  save_state();
 }
 
 void loop() {
+  if(unifying_state_counter_lease_due(&state)) {
+    renew_counter_lease();
+  }
+
   // Check if the user has pressed any keys.
   scan_keyboard_matrix();
 
@@ -63,6 +63,13 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
   #define MULTIPLY_AS_A_FUNCTION 0
 #endif
 
+// Define AES_TTABLE as 1 to encrypt with 32-bit table lookups instead of byte-wise SubBytes/ShiftRows/MixColumns.
+// This is much faster on 32/64-bit CPUs but costs an additional 1KB of read-only storage.
+// Only encryption (ECB/CBC encrypt and CTR) is affected. Decryption always uses the byte-oriented code.
+#ifndef AES_TTABLE
+  #define AES_TTABLE 0
+#endif
+
 
 
 
@@ -119,6 +126,45 @@ static const uint8_t rsbox[256] = {
 static const uint8_t Rcon[11] = {
   0x8d, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
 
+#if defined(AES_TTABLE) && (AES_TTABLE == 1)
+// Combined SubBytes and MixColumns lookup-table.
+// Te0[x] holds the column {02}*S[x], S[x], S[x], {03}*S[x] with the first row in the most significant byte.
+// The tables for the other rows are rotations of this one.
+static const uint32_t Te0[256] = {
+  0xc66363a5U, 0xf87c7c84U, 0xee777799U, 0xf67b7b8dU, 0xfff2f20dU, 0xd66b6bbdU, 0xde6f6fb1U, 0x91c5c554U,
+  0x60303050U, 0x02010103U, 0xce6767a9U, 0x562b2b7dU, 0xe7fefe19U, 0xb5d7d762U, 0x4dababe6U, 0xec76769aU,
+  0x8fcaca45U, 0x1f82829dU, 0x89c9c940U, 0xfa7d7d87U, 0xeffafa15U, 0xb25959ebU, 0x8e4747c9U, 0xfbf0f00bU,
+  0x41adadecU, 0xb3d4d467U, 0x5fa2a2fdU, 0x45afafeaU, 0x239c9cbfU, 0x53a4a4f7U, 0xe4727296U, 0x9bc0c05bU,
+  0x75b7b7c2U, 0xe1fdfd1cU, 0x3d9393aeU, 0x4c26266aU, 0x6c36365aU, 0x7e3f3f41U, 0xf5f7f702U, 0x83cccc4fU,
+  0x6834345cU, 0x51a5a5f4U, 0xd1e5e534U, 0xf9f1f108U, 0xe2717193U, 0xabd8d873U, 0x62313153U, 0x2a15153fU,
+  0x0804040cU, 0x95c7c752U, 0x46232365U, 0x9dc3c35eU, 0x30181828U, 0x379696a1U, 0x0a05050fU, 0x2f9a9ab5U,
+  0x0e070709U, 0x24121236U, 0x1b80809bU, 0xdfe2e23dU, 0xcdebeb26U, 0x4e272769U, 0x7fb2b2cdU, 0xea75759fU,
+  0x1209091bU, 0x1d83839eU, 0x582c2c74U, 0x341a1a2eU, 0x361b1b2dU, 0xdc6e6eb2U, 0xb45a5aeeU, 0x5ba0a0fbU,
+  0xa45252f6U, 0x763b3b4dU, 0xb7d6d661U, 0x7db3b3ceU, 0x5229297bU, 0xdde3e33eU, 0x5e2f2f71U, 0x13848497U,
+  0xa65353f5U, 0xb9d1d168U, 0x00000000U, 0xc1eded2cU, 0x40202060U, 0xe3fcfc1fU, 0x79b1b1c8U, 0xb65b5bedU,
+  0xd46a6abeU, 0x8dcbcb46U, 0x67bebed9U, 0x7239394bU, 0x944a4adeU, 0x984c4cd4U, 0xb05858e8U, 0x85cfcf4aU,
+  0xbbd0d06bU, 0xc5efef2aU, 0x4faaaae5U, 0xedfbfb16U, 0x864343c5U, 0x9a4d4dd7U, 0x66333355U, 0x11858594U,
+  0x8a4545cfU, 0xe9f9f910U, 0x04020206U, 0xfe7f7f81U, 0xa05050f0U, 0x783c3c44U, 0x259f9fbaU, 0x4ba8a8e3U,
+  0xa25151f3U, 0x5da3a3feU, 0x804040c0U, 0x058f8f8aU, 0x3f9292adU, 0x219d9dbcU, 0x70383848U, 0xf1f5f504U,
+  0x63bcbcdfU, 0x77b6b6c1U, 0xafdada75U, 0x42212163U, 0x20101030U, 0xe5ffff1aU, 0xfdf3f30eU, 0xbfd2d26dU,
+  0x81cdcd4cU, 0x180c0c14U, 0x26131335U, 0xc3ecec2fU, 0xbe5f5fe1U, 0x359797a2U, 0x884444ccU, 0x2e171739U,
+  0x93c4c457U, 0x55a7a7f2U, 0xfc7e7e82U, 0x7a3d3d47U, 0xc86464acU, 0xba5d5de7U, 0x3219192bU, 0xe6737395U,
+  0xc06060a0U, 0x19818198U, 0x9e4f4fd1U, 0xa3dcdc7fU, 0x44222266U, 0x542a2a7eU, 0x3b9090abU, 0x0b888883U,
+  0x8c4646caU, 0xc7eeee29U, 0x6bb8b8d3U, 0x2814143cU, 0xa7dede79U, 0xbc5e5ee2U, 0x160b0b1dU, 0xaddbdb76U,
+  0xdbe0e03bU, 0x64323256U, 0x743a3a4eU, 0x140a0a1eU, 0x924949dbU, 0x0c06060aU, 0x4824246cU, 0xb85c5ce4U,
+  0x9fc2c25dU, 0xbdd3d36eU, 0x43acacefU, 0xc46262a6U, 0x399191a8U, 0x319595a4U, 0xd3e4e437U, 0xf279798bU,
+  0xd5e7e732U, 0x8bc8c843U, 0x6e373759U, 0xda6d6db7U, 0x018d8d8cU, 0xb1d5d564U, 0x9c4e4ed2U, 0x49a9a9e0U,
+  0xd86c6cb4U, 0xac5656faU, 0xf3f4f407U, 0xcfeaea25U, 0xca6565afU, 0xf47a7a8eU, 0x47aeaee9U, 0x10080818U,
+  0x6fbabad5U, 0xf0787888U, 0x4a25256fU, 0x5c2e2e72U, 0x381c1c24U, 0x57a6a6f1U, 0x73b4b4c7U, 0x97c6c651U,
+  0xcbe8e823U, 0xa1dddd7cU, 0xe874749cU, 0x3e1f1f21U, 0x964b4bddU, 0x61bdbddcU, 0x0d8b8b86U, 0x0f8a8a85U,
+  0xe0707090U, 0x7c3e3e42U, 0x71b5b5c4U, 0xcc6666aaU, 0x904848d8U, 0x06030305U, 0xf7f6f601U, 0x1c0e0e12U,
+  0xc26161a3U, 0x6a35355fU, 0xae5757f9U, 0x69b9b9d0U, 0x17868691U, 0x99c1c158U, 0x3a1d1d27U, 0x279e9eb9U,
+  0xd9e1e138U, 0xebf8f813U, 0x2b9898b3U, 0x22111133U, 0xd26969bbU, 0xa9d9d970U, 0x078e8e89U, 0x339494a7U,
+  0x2d9b9bb6U, 0x3c1e1e22U, 0x15878792U, 0xc9e9e920U, 0x87cece49U, 0xaa5555ffU, 0x50282878U, 0xa5dfdf7aU,
+  0x038c8c8fU, 0x59a1a1f8U, 0x09898980U, 0x1a0d0d17U, 0x65bfbfdaU, 0xd7e6e631U, 0x844242c6U, 0xd06868b8U,
+  0x824141c3U, 0x299999b0U, 0x5a2d2d77U, 0x1e0f0f11U, 0x7bb0b0cbU, 0xa85454fcU, 0x6dbbbbd6U, 0x2c16163aU };
+#endif
+
 /*
  * Jordan Goulder points out in PR #12 (https://github.com/kokke/tiny-AES-C/pull/12),
  * that you can remove most of the elements in the Rcon array, because they are unused.
@@ -252,6 +298,7 @@ static void AddRoundKey(uint8_t round,state_t* state,uint8_t* RoundKey)
   }
 }
 
+#if !defined(AES_TTABLE) || (AES_TTABLE == 0)
 // The SubBytes Function Substitutes the values in the
 // state matrix with values in an S-box.
 static void SubBytes(state_t* state)
@@ -297,11 +344,14 @@ static void ShiftRows(state_t* state)
   (*state)[1][3] = temp;
 }
 
+#endif // #if !defined(AES_TTABLE) || (AES_TTABLE == 0)
+
 static uint8_t xtime(uint8_t x)
 {
   return ((x<<1) ^ (((x>>7) & 1) * 0x1b));
 }
 
+#if !defined(AES_TTABLE) || (AES_TTABLE == 0)
 // MixColumns function mixes the columns of the state matrix
 static void MixColumns(state_t* state)
 {
@@ -318,6 +368,8 @@ static void MixColumns(state_t* state)
   }
 }
 
+#endif // #if !defined(AES_TTABLE) || (AES_TTABLE == 0)
+
 // Multiply is used to multiply numbers in the field GF(2^8)
 // Note: The last call to xtime() is unneeded, but often ends up generating a smaller binary
 //       The compiler seems to be able to vectorize the operation better this way.
@@ -407,6 +459,120 @@ static void InvShiftRows(state_t* state)
 }
 #endif // #if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
 
+#if defined(AES_TTABLE) && (AES_TTABLE == 1)
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define GETU32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | ((uint32_t)(p)[3]))
+#define PUTU32(p, v) { (p)[0] = (uint8_t)((v) >> 24); (p)[1] = (uint8_t)((v) >> 16); \
+                       (p)[2] = (uint8_t)((v) >> 8); (p)[3] = (uint8_t)(v); }
+
+// One full round on column words s0..s3 with ShiftRows folded into the choice of source columns.
+#define TTABLE_COLUMN(a, b, c, d, rk)                         \
+      (Te0[(a) >> 24] ^                                       \
+       ROTR32(Te0[((b) >> 16) & 0xff], 8) ^                   \
+       ROTR32(Te0[((c) >> 8) & 0xff], 16) ^                   \
+       ROTR32(Te0[(d) & 0xff], 24) ^ GETU32(rk))
+
+// The last round has no MixColumns so only the S-box is used.
+#define TTABLE_FINAL_COLUMN(a, b, c, d, rk)                   \
+      ((((uint32_t)getSBoxValue((a) >> 24)) << 24 |           \
+        ((uint32_t)getSBoxValue(((b) >> 16) & 0xff)) << 16 |  \
+        ((uint32_t)getSBoxValue(((c) >> 8) & 0xff)) << 8 |    \
+        ((uint32_t)getSBoxValue((d) & 0xff))) ^ GETU32(rk))
+
+// Cipher is the main function that encrypts the PlainText.
+// Each column of the state is kept in a 32-bit word, most significant byte first.
+static void Cipher(state_t* state, const uint8_t* RoundKey)
+{
+  uint8_t* buf = (uint8_t*)state;
+  uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+  uint8_t round;
+
+  // Add the First round key to the state before starting the rounds.
+  s0 = GETU32(buf +  0) ^ GETU32(RoundKey +  0);
+  s1 = GETU32(buf +  4) ^ GETU32(RoundKey +  4);
+  s2 = GETU32(buf +  8) ^ GETU32(RoundKey +  8);
+  s3 = GETU32(buf + 12) ^ GETU32(RoundKey + 12);
+
+  // The first Nr-1 rounds are identical.
+  for (round = 1; round < Nr; ++round)
+  {
+    const uint8_t* rk = RoundKey + (round * Nb * 4);
+    t0 = TTABLE_COLUMN(s0, s1, s2, s3, rk +  0);
+    t1 = TTABLE_COLUMN(s1, s2, s3, s0, rk +  4);
+    t2 = TTABLE_COLUMN(s2, s3, s0, s1, rk +  8);
+    t3 = TTABLE_COLUMN(s3, s0, s1, s2, rk + 12);
+    s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+  }
+
+  // The last round is given below.
+  {
+    const uint8_t* rk = RoundKey + (Nr * Nb * 4);
+    t0 = TTABLE_FINAL_COLUMN(s0, s1, s2, s3, rk +  0);
+    t1 = TTABLE_FINAL_COLUMN(s1, s2, s3, s0, rk +  4);
+    t2 = TTABLE_FINAL_COLUMN(s2, s3, s0, s1, rk +  8);
+    t3 = TTABLE_FINAL_COLUMN(s3, s0, s1, s2, rk + 12);
+  }
+
+  PUTU32(buf +  0, t0);
+  PUTU32(buf +  4, t1);
+  PUTU32(buf +  8, t2);
+  PUTU32(buf + 12, t3);
+}
+
+#if defined(ECB) && (ECB == 1)
+// Number of blocks that CipherBlocks() keeps in flight.
+#define CIPHER_LANES 4
+
+// Encrypt up to CIPHER_LANES independent blocks, each with its own key schedule.
+// The blocks advance through the rounds together so their table lookups can overlap.
+static void CipherBlocks(uint8_t* buf, const uint8_t* const* RoundKey, uint8_t blocks)
+{
+  uint32_t s[CIPHER_LANES][4], t[CIPHER_LANES][4];
+  uint8_t round, b, c;
+
+  for (b = 0; b < blocks; ++b)
+  {
+    for (c = 0; c < 4; ++c)
+    {
+      s[b][c] = GETU32(buf + (b * AES_BLOCKLEN) + (c * 4)) ^ GETU32(RoundKey[b] + (c * 4));
+    }
+  }
+
+  for (round = 1; round < Nr; ++round)
+  {
+    for (b = 0; b < blocks; ++b)
+    {
+      const uint8_t* rk = RoundKey[b] + (round * Nb * 4);
+      t[b][0] = TTABLE_COLUMN(s[b][0], s[b][1], s[b][2], s[b][3], rk +  0);
+      t[b][1] = TTABLE_COLUMN(s[b][1], s[b][2], s[b][3], s[b][0], rk +  4);
+      t[b][2] = TTABLE_COLUMN(s[b][2], s[b][3], s[b][0], s[b][1], rk +  8);
+      t[b][3] = TTABLE_COLUMN(s[b][3], s[b][0], s[b][1], s[b][2], rk + 12);
+    }
+    for (b = 0; b < blocks; ++b)
+    {
+      s[b][0] = t[b][0]; s[b][1] = t[b][1]; s[b][2] = t[b][2]; s[b][3] = t[b][3];
+    }
+  }
+
+  for (b = 0; b < blocks; ++b)
+  {
+    const uint8_t* rk = RoundKey[b] + (Nr * Nb * 4);
+    uint8_t* out = buf + (b * AES_BLOCKLEN);
+    t[b][0] = TTABLE_FINAL_COLUMN(s[b][0], s[b][1], s[b][2], s[b][3], rk +  0);
+    t[b][1] = TTABLE_FINAL_COLUMN(s[b][1], s[b][2], s[b][3], s[b][0], rk +  4);
+    t[b][2] = TTABLE_FINAL_COLUMN(s[b][2], s[b][3], s[b][0], s[b][1], rk +  8);
+    t[b][3] = TTABLE_FINAL_COLUMN(s[b][3], s[b][0], s[b][1], s[b][2], rk + 12);
+    PUTU32(out +  0, t[b][0]);
+    PUTU32(out +  4, t[b][1]);
+    PUTU32(out +  8, t[b][2]);
+    PUTU32(out + 12, t[b][3]);
+  }
+}
+#endif // #if defined(ECB) && (ECB == 1)
+
+#else
+
 // Cipher is the main function that encrypts the PlainText.
 static void Cipher(state_t* state, uint8_t* RoundKey)
 {
@@ -433,6 +599,8 @@ static void Cipher(state_t* state, uint8_t* RoundKey)
   AddRoundKey(Nr, state, RoundKey);
 }
 
+#endif // #if defined(AES_TTABLE) && (AES_TTABLE == 1)
+
 #if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
 static void InvCipher(state_t* state,uint8_t* RoundKey)
 {
@@ -478,6 +646,34 @@ void AES_ECB_decrypt(struct AES_ctx* ctx, uint8_t* buf)
   InvCipher((state_t*)buf, ctx->RoundKey);
 }
 
+void AES_ECB_encrypt_blocks(struct AES_ctx* const* ctx, uint8_t* buf, uint32_t blocks)
+{
+#if defined(AES_TTABLE) && (AES_TTABLE == 1)
+  const uint8_t* RoundKey[CIPHER_LANES];
+  uint8_t lanes, b;
+
+  while (blocks)
+  {
+    lanes = (blocks < CIPHER_LANES) ? blocks : CIPHER_LANES;
+    for (b = 0; b < lanes; ++b)
+    {
+      RoundKey[b] = ctx[b]->RoundKey;
+    }
+    CipherBlocks(buf, RoundKey, lanes);
+    ctx += lanes;
+    buf += lanes * AES_BLOCKLEN;
+    blocks -= lanes;
+  }
+#else
+  // The byte-oriented rounds gain nothing from interleaving.
+  uint32_t i;
+  for (i = 0; i < blocks; ++i)
+  {
+    Cipher((state_t*)(buf + (i * AES_BLOCKLEN)), ctx[i]->RoundKey);
+  }
+#endif
+}
+
 
 #endif // #if defined(ECB) && (ECB == 1)
 
@@ -570,3 +766,495 @@ void AES_CTR_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, uint32_t length)
 
 #endif // #if defined(CTR) && (CTR == 1)
 
+
+
+
+#if defined(AES_BITSLICE) && (AES_BITSLICE == 1)
+
+// Bitsliced AES after the "ct64" design by Thomas Pornin (BearSSL).
+// Eight 64-bit words hold one bit of every byte of 4 blocks each, so SubBytes becomes a
+// Boyar-Peralta boolean circuit and all other steps are shifts and XORs. No secret value is
+// ever used as an index or branch condition.
+// With GCC vector extensions every word carries several 64-bit lanes, giving
+// AES_BITSLICE_BLOCKS blocks per pass (SSE2: 8, AVX2: 16). Otherwise plain uint64_t is used.
+#define BITSLICE_LANES (AES_BITSLICE_BLOCKS / 4)
+
+#if BITSLICE_LANES > 1
+typedef uint64_t bitslice_t __attribute__((vector_size(8 * BITSLICE_LANES)));
+#else
+typedef uint64_t bitslice_t;
+#endif
+
+#define BITSLICE_SWAPN(cl, ch, s, x, y)                           \
+  do {                                                            \
+    bitslice_t a = (x), b = (y);                                  \
+    (x) = (a & (uint64_t)(cl)) | ((b & (uint64_t)(cl)) << (s));   \
+    (y) = ((a & (uint64_t)(ch)) >> (s)) | (b & (uint64_t)(ch));   \
+  } while (0)
+
+// Transpose between 8 words of interleaved bytes and 8 words of bit planes. This is its own inverse.
+static void BitsliceOrtho(bitslice_t* q)
+{
+  BITSLICE_SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, q[0], q[1]);
+  BITSLICE_SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, q[2], q[3]);
+  BITSLICE_SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, q[4], q[5]);
+  BITSLICE_SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, q[6], q[7]);
+
+  BITSLICE_SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, q[0], q[2]);
+  BITSLICE_SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, q[1], q[3]);
+  BITSLICE_SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, q[4], q[6]);
+  BITSLICE_SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, q[5], q[7]);
+
+  BITSLICE_SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, q[0], q[4]);
+  BITSLICE_SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, q[1], q[5]);
+  BITSLICE_SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, q[2], q[6]);
+  BITSLICE_SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, q[3], q[7]);
+}
+
+// Spread one block over two 64-bit words, 16 bits per column pair.
+static void BitsliceInterleaveIn(uint64_t* q0, uint64_t* q1, const uint8_t* block)
+{
+  uint64_t x[4];
+  uint8_t i;
+
+  for (i = 0; i < 4; ++i)
+  {
+    x[i] = (uint64_t)block[(i * 4) + 0]
+         | ((uint64_t)block[(i * 4) + 1] << 8)
+         | ((uint64_t)block[(i * 4) + 2] << 16)
+         | ((uint64_t)block[(i * 4) + 3] << 24);
+    x[i] |= (x[i] << 16);
+    x[i] &= 0x0000FFFF0000FFFFULL;
+    x[i] |= (x[i] << 8);
+    x[i] &= 0x00FF00FF00FF00FFULL;
+  }
+  *q0 = x[0] | (x[2] << 8);
+  *q1 = x[1] | (x[3] << 8);
+}
+
+static void BitsliceInterleaveOut(uint8_t* block, uint64_t q0, uint64_t q1)
+{
+  uint64_t x[4];
+  uint8_t i;
+
+  x[0] = q0 & 0x00FF00FF00FF00FFULL;
+  x[1] = q1 & 0x00FF00FF00FF00FFULL;
+  x[2] = (q0 >> 8) & 0x00FF00FF00FF00FFULL;
+  x[3] = (q1 >> 8) & 0x00FF00FF00FF00FFULL;
+  for (i = 0; i < 4; ++i)
+  {
+    x[i] |= (x[i] >> 8);
+    x[i] &= 0x0000FFFF0000FFFFULL;
+    x[i] |= (x[i] >> 16);
+    block[(i * 4) + 0] = (uint8_t)x[i];
+    block[(i * 4) + 1] = (uint8_t)(x[i] >> 8);
+    block[(i * 4) + 2] = (uint8_t)(x[i] >> 16);
+    block[(i * 4) + 3] = (uint8_t)(x[i] >> 24);
+  }
+}
+
+// Load up to AES_BITSLICE_BLOCKS blocks into bitsliced form. Missing blocks are zero.
+// Lane l of the words holds blocks 4l to 4l+3.
+static void BitsliceLoad(bitslice_t* q, const uint8_t* buf, uint32_t blocks)
+{
+  uint64_t w[8][BITSLICE_LANES];
+  uint8_t block[AES_BLOCKLEN];
+  uint32_t b;
+
+  for (b = 0; b < AES_BITSLICE_BLOCKS; ++b)
+  {
+    if (b < blocks)
+    {
+      memcpy(block, buf + (b * AES_BLOCKLEN), AES_BLOCKLEN);
+    }
+    else
+    {
+      memset(block, 0, AES_BLOCKLEN);
+    }
+    BitsliceInterleaveIn(&w[b % 4][b / 4], &w[(b % 4) + 4][b / 4], block);
+  }
+  memcpy(q, w, sizeof(w));
+  BitsliceOrtho(q);
+}
+
+static void BitsliceStore(uint8_t* buf, bitslice_t* q, uint32_t blocks)
+{
+  uint64_t w[8][BITSLICE_LANES];
+  uint32_t b;
+
+  BitsliceOrtho(q);
+  memcpy(w, q, sizeof(w));
+  for (b = 0; b < blocks; ++b)
+  {
+    BitsliceInterleaveOut(buf + (b * AES_BLOCKLEN), w[b % 4][b / 4], w[(b % 4) + 4][b / 4]);
+  }
+}
+
+// SubBytes as the 113 gate circuit from Boyar and Peralta, "A depth-16 circuit for the AES S-box".
+static void BitsliceSubBytes(bitslice_t* q)
+{
+  bitslice_t x0, x1, x2, x3, x4, x5, x6, x7;
+  bitslice_t y1, y2, y3, y4, y5, y6, y7, y8, y9, y10, y11;
+  bitslice_t y12, y13, y14, y15, y16, y17, y18, y19, y20, y21;
+  bitslice_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+  bitslice_t z10, z11, z12, z13, z14, z15, z16, z17;
+  bitslice_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+  bitslice_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+  bitslice_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+  bitslice_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+  bitslice_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+  bitslice_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+  bitslice_t t60, t61, t62, t63, t64, t65, t66, t67;
+  bitslice_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+  x0 = q[7];
+  x1 = q[6];
+  x2 = q[5];
+  x3 = q[4];
+  x4 = q[3];
+  x5 = q[2];
+  x6 = q[1];
+  x7 = q[0];
+
+  // Top linear transformation.
+  y14 = x3 ^ x5;
+  y13 = x0 ^ x6;
+  y9 = x0 ^ x3;
+  y8 = x0 ^ x5;
+  t0 = x1 ^ x2;
+  y1 = t0 ^ x7;
+  y4 = y1 ^ x3;
+  y12 = y13 ^ y14;
+  y2 = y1 ^ x0;
+  y5 = y1 ^ x6;
+  y3 = y5 ^ y8;
+  t1 = x4 ^ y12;
+  y15 = t1 ^ x5;
+  y20 = t1 ^ x1;
+  y6 = y15 ^ x7;
+  y10 = y15 ^ t0;
+  y11 = y20 ^ y9;
+  y7 = x7 ^ y11;
+  y17 = y10 ^ y11;
+  y19 = y10 ^ y8;
+  y16 = t0 ^ y11;
+  y21 = y13 ^ y16;
+  y18 = x0 ^ y16;
+
+  // Non-linear section.
+  t2 = y12 & y15;
+  t3 = y3 & y6;
+  t4 = t3 ^ t2;
+  t5 = y4 & x7;
+  t6 = t5 ^ t2;
+  t7 = y13 & y16;
+  t8 = y5 & y1;
+  t9 = t8 ^ t7;
+  t10 = y2 & y7;
+  t11 = t10 ^ t7;
+  t12 = y9 & y11;
+  t13 = y14 & y17;
+  t14 = t13 ^ t12;
+  t15 = y8 & y10;
+  t16 = t15 ^ t12;
+  t17 = t4 ^ t14;
+  t18 = t6 ^ t16;
+  t19 = t9 ^ t14;
+  t20 = t11 ^ t16;
+  t21 = t17 ^ y20;
+  t22 = t18 ^ y19;
+  t23 = t19 ^ y21;
+  t24 = t20 ^ y18;
+
+  t25 = t21 ^ t22;
+  t26 = t21 & t23;
+  t27 = t24 ^ t26;
+  t28 = t25 & t27;
+  t29 = t28 ^ t22;
+  t30 = t23 ^ t24;
+  t31 = t22 ^ t26;
+  t32 = t31 & t30;
+  t33 = t32 ^ t24;
+  t34 = t23 ^ t33;
+  t35 = t27 ^ t33;
+  t36 = t24 & t35;
+  t37 = t36 ^ t34;
+  t38 = t27 ^ t36;
+  t39 = t29 & t38;
+  t40 = t25 ^ t39;
+
+  t41 = t40 ^ t37;
+  t42 = t29 ^ t33;
+  t43 = t29 ^ t40;
+  t44 = t33 ^ t37;
+  t45 = t42 ^ t41;
+  z0 = t44 & y15;
+  z1 = t37 & y6;
+  z2 = t33 & x7;
+  z3 = t43 & y16;
+  z4 = t40 & y1;
+  z5 = t29 & y7;
+  z6 = t42 & y11;
+  z7 = t45 & y17;
+  z8 = t41 & y10;
+  z9 = t44 & y12;
+  z10 = t37 & y3;
+  z11 = t33 & y4;
+  z12 = t43 & y13;
+  z13 = t40 & y5;
+  z14 = t29 & y2;
+  z15 = t42 & y9;
+  z16 = t45 & y14;
+  z17 = t41 & y8;
+
+  // Bottom linear transformation.
+  t46 = z15 ^ z16;
+  t47 = z10 ^ z11;
+  t48 = z5 ^ z13;
+  t49 = z9 ^ z10;
+  t50 = z2 ^ z12;
+  t51 = z2 ^ z5;
+  t52 = z7 ^ z8;
+  t53 = z0 ^ z3;
+  t54 = z6 ^ z7;
+  t55 = z16 ^ z17;
+  t56 = z12 ^ t48;
+  t57 = t50 ^ t53;
+  t58 = z4 ^ t46;
+  t59 = z3 ^ t54;
+  t60 = t46 ^ t57;
+  t61 = z14 ^ t57;
+  t62 = t52 ^ t58;
+  t63 = t49 ^ t58;
+  t64 = z4 ^ t59;
+  t65 = t61 ^ t62;
+  t66 = z1 ^ t63;
+  s0 = t59 ^ t63;
+  s6 = t56 ^ ~t62;
+  s7 = t48 ^ ~t60;
+  t67 = t64 ^ t65;
+  s3 = t53 ^ t66;
+  s4 = t51 ^ t66;
+  s5 = t47 ^ t65;
+  s1 = t64 ^ ~s3;
+  s2 = t55 ^ ~t67;
+
+  q[7] = s0;
+  q[6] = s1;
+  q[5] = s2;
+  q[4] = s3;
+  q[3] = s4;
+  q[2] = s5;
+  q[1] = s6;
+  q[0] = s7;
+}
+
+static void BitsliceShiftRows(bitslice_t* q)
+{
+  uint8_t i;
+  for (i = 0; i < 8; ++i)
+  {
+    bitslice_t x = q[i];
+    q[i] = (x & 0x000000000000FFFFULL)
+         | ((x & 0x00000000FFF00000ULL) >> 4)
+         | ((x & 0x00000000000F0000ULL) << 12)
+         | ((x & 0x0000FF0000000000ULL) >> 8)
+         | ((x & 0x000000FF00000000ULL) << 8)
+         | ((x & 0xF000000000000000ULL) >> 12)
+         | ((x & 0x0FFF000000000000ULL) << 4);
+  }
+}
+
+#define BITSLICE_ROTR16(x) (((x) >> 16) | ((x) << 48))
+#define BITSLICE_ROTR32(x) (((x) >> 32) | ((x) << 32))
+
+static void BitsliceMixColumns(bitslice_t* q)
+{
+  bitslice_t q0, q1, q2, q3, q4, q5, q6, q7;
+  bitslice_t r0, r1, r2, r3, r4, r5, r6, r7;
+
+  q0 = q[0]; q1 = q[1]; q2 = q[2]; q3 = q[3];
+  q4 = q[4]; q5 = q[5]; q6 = q[6]; q7 = q[7];
+  r0 = BITSLICE_ROTR16(q0); r1 = BITSLICE_ROTR16(q1);
+  r2 = BITSLICE_ROTR16(q2); r3 = BITSLICE_ROTR16(q3);
+  r4 = BITSLICE_ROTR16(q4); r5 = BITSLICE_ROTR16(q5);
+  r6 = BITSLICE_ROTR16(q6); r7 = BITSLICE_ROTR16(q7);
+
+  q[0] = q7 ^ r7 ^ r0 ^ BITSLICE_ROTR32(q0 ^ r0);
+  q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ BITSLICE_ROTR32(q1 ^ r1);
+  q[2] = q1 ^ r1 ^ r2 ^ BITSLICE_ROTR32(q2 ^ r2);
+  q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ BITSLICE_ROTR32(q3 ^ r3);
+  q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ BITSLICE_ROTR32(q4 ^ r4);
+  q[5] = q4 ^ r4 ^ r5 ^ BITSLICE_ROTR32(q5 ^ r5);
+  q[6] = q5 ^ r5 ^ r6 ^ BITSLICE_ROTR32(q6 ^ r6);
+  q[7] = q6 ^ r6 ^ r7 ^ BITSLICE_ROTR32(q7 ^ r7);
+}
+
+// Round keys are identical in every lane, so a single 64-bit word per bit plane is broadcast.
+static void BitsliceAddRoundKey(uint8_t round, bitslice_t* q, const uint64_t* RoundKey)
+{
+  uint8_t i;
+  for (i = 0; i < 8; ++i)
+  {
+    q[i] ^= RoundKey[(round * 8) + i];
+  }
+}
+
+static void BitsliceCipher(bitslice_t* q, const uint64_t* RoundKey)
+{
+  uint8_t round;
+
+  BitsliceAddRoundKey(0, q, RoundKey);
+  for (round = 1; round < Nr; ++round)
+  {
+    BitsliceSubBytes(q);
+    BitsliceShiftRows(q);
+    BitsliceMixColumns(q);
+    BitsliceAddRoundKey(round, q, RoundKey);
+  }
+  BitsliceSubBytes(q);
+  BitsliceShiftRows(q);
+  BitsliceAddRoundKey(Nr, q, RoundKey);
+}
+
+// SubWord() through the bitsliced S-box so that key expansion doesn't index sbox[] with key bytes.
+static void BitsliceSubWord(uint8_t* word)
+{
+  bitslice_t q[8];
+  uint8_t block[AES_BLOCKLEN];
+
+  memset(block, 0, AES_BLOCKLEN);
+  memcpy(block, word, 4);
+  BitsliceLoad(q, block, 1);
+  BitsliceSubBytes(q);
+  BitsliceStore(block, q, 1);
+  memcpy(word, block, 4);
+}
+
+static void BitsliceKeyExpansion(uint64_t* RoundKey, const uint8_t* Key)
+{
+  uint8_t expanded[AES_keyExpSize];
+  uint8_t tempa[4];
+  bitslice_t q[8];
+  uint64_t w[8][BITSLICE_LANES];
+  unsigned i, j;
+
+  // Same schedule as KeyExpansion().
+  memcpy(expanded, Key, AES_KEYLEN);
+  for (i = Nk; i < Nb * (Nr + 1); ++i)
+  {
+    memcpy(tempa, expanded + ((i - 1) * 4), 4);
+    if (i % Nk == 0)
+    {
+      const uint8_t u8tmp = tempa[0];
+      tempa[0] = tempa[1];
+      tempa[1] = tempa[2];
+      tempa[2] = tempa[3];
+      tempa[3] = u8tmp;
+      BitsliceSubWord(tempa);
+      tempa[0] = tempa[0] ^ Rcon[i/Nk];
+    }
+#if defined(AES256) && (AES256 == 1)
+    if (i % Nk == 4)
+    {
+      BitsliceSubWord(tempa);
+    }
+#endif
+    for (j = 0; j < 4; ++j)
+    {
+      expanded[(i * 4) + j] = expanded[((i - Nk) * 4) + j] ^ tempa[j];
+    }
+  }
+
+  // Bitslice every round key as if it were 4 copies of the same block and keep the first lane.
+  memset(w, 0, sizeof(w));
+  for (i = 0; i < Nr + 1; ++i)
+  {
+    for (j = 0; j < 4; ++j)
+    {
+      BitsliceInterleaveIn(&w[j][0], &w[j + 4][0], expanded + (i * AES_BLOCKLEN));
+    }
+    memcpy(q, w, sizeof(w));
+    BitsliceOrtho(q);
+    memcpy(w, q, sizeof(w));
+    for (j = 0; j < 8; ++j)
+    {
+      RoundKey[(i * 8) + j] = w[j][0];
+    }
+  }
+}
+
+void AES_bitslice_init_ctx(struct AES_bitslice_ctx* ctx, const uint8_t* key)
+{
+  BitsliceKeyExpansion(ctx->RoundKey, key);
+}
+
+void AES_bitslice_init_ctx_iv(struct AES_bitslice_ctx* ctx, const uint8_t* key, const uint8_t* iv)
+{
+  BitsliceKeyExpansion(ctx->RoundKey, key);
+  memcpy (ctx->Iv, iv, AES_BLOCKLEN);
+}
+
+void AES_bitslice_ctx_set_iv(struct AES_bitslice_ctx* ctx, const uint8_t* iv)
+{
+  memcpy (ctx->Iv, iv, AES_BLOCKLEN);
+}
+
+void AES_bitslice_ECB_encrypt_blocks(const struct AES_bitslice_ctx* ctx, uint8_t* buf, uint32_t blocks)
+{
+  bitslice_t q[8];
+  uint32_t lanes;
+
+  while (blocks)
+  {
+    lanes = (blocks < AES_BITSLICE_BLOCKS) ? blocks : AES_BITSLICE_BLOCKS;
+    BitsliceLoad(q, buf, lanes);
+    BitsliceCipher(q, ctx->RoundKey);
+    BitsliceStore(buf, q, lanes);
+    buf += lanes * AES_BLOCKLEN;
+    blocks -= lanes;
+  }
+}
+
+/* Symmetrical operation: same function for encrypting as for decrypting. Note any IV/nonce should never be reused with the same key */
+void AES_bitslice_CTR_xcrypt_buffer(struct AES_bitslice_ctx* ctx, uint8_t* buf, uint32_t length)
+{
+  uint8_t buffer[AES_BITSLICE_BLOCKS * AES_BLOCKLEN];
+  uint32_t i, blocks, b;
+  int bi;
+
+  while (length)
+  {
+    blocks = (length + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+    if (blocks > AES_BITSLICE_BLOCKS)
+    {
+      blocks = AES_BITSLICE_BLOCKS;
+    }
+
+    for (b = 0; b < blocks; ++b)
+    {
+      memcpy(buffer + (b * AES_BLOCKLEN), ctx->Iv, AES_BLOCKLEN);
+
+      /* Increment Iv and handle overflow */
+      for (bi = (AES_BLOCKLEN - 1); bi >= 0; --bi)
+      {
+        ctx->Iv[bi] += 1;
+        if (ctx->Iv[bi] != 0)
+        {
+          break;
+        }
+      }
+    }
+
+    AES_bitslice_ECB_encrypt_blocks(ctx, buffer, blocks);
+
+    for (i = 0; (i < blocks * AES_BLOCKLEN) && (i < length); ++i)
+    {
+      buf[i] ^= buffer[i];
+    }
+    buf += i;
+    length -= i;
+  }
+}
+
+#endif // #if defined(AES_BITSLICE) && (AES_BITSLICE == 1)
@@ -22,6 +22,12 @@
   #define CTR 1
 #endif
 
+// AES_BITSLICE enables constant-time bitsliced encryption of many blocks at once.
+// It only pays off with 64-bit or vector registers, so it is off by default. See `make bench`.
+#ifndef AES_BITSLICE
+  #define AES_BITSLICE 0
+#endif
+
 
 #define AES128 1
 //#define AES192 1
@@ -61,6 +67,11 @@ void AES_ctx_set_iv(struct AES_ctx* ctx, const uint8_t* iv);
 void AES_ECB_encrypt(struct AES_ctx* ctx, uint8_t* buf);
 void AES_ECB_decrypt(struct AES_ctx* ctx, uint8_t* buf);
 
+// Encrypt 'blocks' independent blocks stored back to back in buf.
+// Block i is encrypted with ctx[i], so every block may use a different key.
+// Several blocks are processed in lockstep so that their rounds can overlap.
+void AES_ECB_encrypt_blocks(struct AES_ctx* const* ctx, uint8_t* buf, uint32_t blocks);
+
 #endif // #if defined(ECB) && (ECB == !)
 
 
@@ -87,4 +98,38 @@ void AES_CTR_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, uint32_t length);
 #endif // #if defined(CTR) && (CTR == 1)
 
 
+#if defined(AES_BITSLICE) && (AES_BITSLICE == 1)
+
+// Number of blocks encrypted together by one pass of the bitsliced cipher.
+// Each 64-bit lane holds 4 blocks; SSE2 and AVX2 registers hold 2 and 4 lanes.
+#if defined(__GNUC__) && defined(__AVX2__)
+  #define AES_BITSLICE_BLOCKS 16
+#elif defined(__GNUC__) && defined(__SSE2__)
+  #define AES_BITSLICE_BLOCKS 8
+#else
+  #define AES_BITSLICE_BLOCKS 4
+#endif
+
+// Round keys are stored pre-bitsliced, 8 words per round.
+// No table lookups or data-dependent branches are made on key or data, including during key expansion.
+struct AES_bitslice_ctx
+{
+  uint64_t RoundKey[AES_keyExpSize / 2];
+  uint8_t Iv[AES_BLOCKLEN];
+};
+
+void AES_bitslice_init_ctx(struct AES_bitslice_ctx* ctx, const uint8_t* key);
+void AES_bitslice_init_ctx_iv(struct AES_bitslice_ctx* ctx, const uint8_t* key, const uint8_t* iv);
+void AES_bitslice_ctx_set_iv(struct AES_bitslice_ctx* ctx, const uint8_t* iv);
+
+// Encrypt 'blocks' independent blocks stored back to back in buf, all with the same key.
+// Throughput is best when blocks is a multiple of AES_BITSLICE_BLOCKS.
+void AES_bitslice_ECB_encrypt_blocks(const struct AES_bitslice_ctx* ctx, uint8_t* buf, uint32_t blocks);
+
+// Same as AES_CTR_xcrypt_buffer() but AES_BITSLICE_BLOCKS counter blocks are encrypted per pass.
+void AES_bitslice_CTR_xcrypt_buffer(struct AES_bitslice_ctx* ctx, uint8_t* buf, uint32_t length);
+
+#endif // #if defined(AES_BITSLICE) && (AES_BITSLICE == 1)
+
+
 #endif //_AES_H_
@@ -4,7 +4,11 @@
 /*!
  * Immediately transmit a payload.
  * 
- * If transmission fails then a new RF channel will be selected and the timeout will not be updated.
+ * The result is recorded in \ref unifying_state.channel_stats "state.channel_stats".
+ * If transmission fails then a new RF channel will be selected with unifying_state_channel_next()
+ * and the timeout will not be updated.
+ * While pairing, the channel is left alone and nothing is recorded,
+ * because the pairing channels are chosen by unifying_pair_sweep().
  * 
  * \param[in,out]   state       Unifying state information.
  * \param[out]      payload     Pointer to a payload to transmit.
@@ -22,12 +26,22 @@ static enum unifying_error unifying_transmit(struct unifying_state* state,
 {
 
     uint8_t err = state->interface->transmit_payload(payload, length);
+    bool pairing = state->pairing.step != UNIFYING_PAIR_STEP_IDLE;
+
+    if(!pairing)
+    {
+        unifying_state_channel_record(state, !err);
+    }
 
     if(err)
     {
         // Transmission failed.
-        // Switch to a new channel.
-        unifying_state_channel_set(state, unifying_next_channel(state->channel));
+        // Switch to the channel most likely to work, unless pairing is choosing the channels.
+        if(!pairing)
+        {
+            unifying_state_channel_set(state, unifying_state_channel_next(state));
+        }
+
         return UNIFYING_TRANSMIT_ERROR;
     }
 
@@ -39,11 +53,25 @@ static enum unifying_error unifying_transmit(struct unifying_state* state,
     }
 
     state->previous_transmit = state->interface->time();
-    state->next_transmit = state->previous_transmit + state->timeout * UNIFYING_TIMEOUT_COEFFICIENT;
+    state->next_transmit = state->previous_transmit + unifying_timeout_interval(state->timeout);
 
     return UNIFYING_SUCCESS;
 }
 
+/*!
+ * Record that an input payload was just transmitted.
+ * 
+ * This starts climbing the \ref unifying_state.idle_ladder "idle timeout ladder" again.
+ * Other payloads, such as HID++ responses and pairing requests, don't count as input.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ */
+static void unifying_input_transmitted(struct unifying_state* state)
+{
+    state->last_activity = state->previous_transmit;
+    state->idle_step = 0;
+}
+
 /*!
  * Queue a received payload in a buffer.
  * 
@@ -51,7 +79,6 @@ static enum unifying_error unifying_transmit(struct unifying_state* state,
  * 
  * \return  \ref UNIFYING_RECEIVE_ERROR if no payload is available.
  * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the receive buffer is full.
- * \return  \ref UNIFYING_CREATE_ERROR if dynamic memory allocation fails.
  * \return  \ref UNIFYING_PAYLOAD_LENGTH_ERROR if the payload's length differs from its expected length.
  *          This should never happen.
  * \return  \ref UNIFYING_SUCCESS otherwise.
@@ -63,7 +90,12 @@ static enum unifying_error unifying_receive(struct unifying_state* state)
         return UNIFYING_RECEIVE_ERROR;
     }
 
-    if(unifying_ring_buffer_full(state->receive_buffer))
+    struct unifying_receive_entry* receive_entry;
+    uint8_t length;
+
+    receive_entry = unifying_ring_buffer_reserve_back(state->receive_buffer);
+
+    if(!receive_entry)
     {
         // We don't have room to store the payload.
         // Maybe we will later.
@@ -71,16 +103,18 @@ static enum unifying_error unifying_receive(struct unifying_state* state)
         return UNIFYING_BUFFER_FULL_ERROR;
     }
 
-    uint8_t length = state->interface->payload_size();
-    struct unifying_receive_entry* receive_entry;
-    receive_entry = unifying_receive_entry_create(length);
+    length = state->interface->payload_size();
 
-    if(!receive_entry)
+    if(length > UNIFYING_MAX_PAYLOAD_LEN)
     {
-        // Memory allocation failed.
-        return UNIFYING_CREATE_ERROR;
+        // No valid Unifying payload is this large.
+        // Read as much as we can store so that the payload gets removed from the radio's RX FIFO.
+        // The length check below will then reject it.
+        length = UNIFYING_MAX_PAYLOAD_LEN;
     }
 
+    unifying_receive_entry_init(receive_entry, length);
+
     // Buffer the received payload for now.
     // It will be handled later.
     length = state->interface->receive_payload(receive_entry->payload, receive_entry->length);
@@ -89,26 +123,25 @@ static enum unifying_error unifying_receive(struct unifying_state* state)
     {
         // Somehow we received a payload of a different size than was stated earlier.
         // This should never happen.
-        unifying_receive_entry_destroy(receive_entry);
+        // The reserved entry is simply not committed.
         return UNIFYING_PAYLOAD_LENGTH_ERROR;
     }
 
-    if(unifying_ring_buffer_push_back(state->receive_buffer, receive_entry))
-    {
-        // The buffer didn't have enough space even though we checked it earlier.
-        // This should never happen.
-        unifying_receive_entry_destroy(receive_entry);
-        return UNIFYING_BUFFER_FULL_ERROR;
-    }
+    unifying_ring_buffer_commit_back(state->receive_buffer);
 
     return UNIFYING_SUCCESS;
 }
 
 /*!
- * Dequeue a received payload and perform basic verification.
+ * Peek at a received payload and perform basic verification.
+ * 
+ * Payloads that fail verification are removed from
+ * \ref unifying_state.receive_buffer "state.receive_buffer".
+ * Otherwise the payload stays buffered and the caller must remove it with
+ * unifying_ring_buffer_pop_front() once it has been unpacked.
  * 
  * \param[in,out]   state           Unifying state information.
- * \param[out]      receive_entry   Pointer to an entry pointer. Used to return the dequeued payload.
+ * \param[out]      receive_entry   Pointer to an entry pointer. Used to return the buffered payload.
  *                                  The pointer is only guaranteed to be valid
  *                                  if this function returns \ref UNIFYING_SUCCESS.
  * \param[in]       length          Expected length of the received payload.
@@ -125,7 +158,7 @@ static enum unifying_error unifying_response(struct unifying_state* state,
                                              struct unifying_receive_entry** receive_entry,
                                              uint8_t length)
 {
-    *receive_entry = unifying_ring_buffer_pop_front(state->receive_buffer);
+    *receive_entry = unifying_ring_buffer_peek_front(state->receive_buffer);
 
     if(!(*receive_entry))
     {
@@ -134,13 +167,13 @@ static enum unifying_error unifying_response(struct unifying_state* state,
 
     if(unifying_checksum_verify((*receive_entry)->payload, (*receive_entry)->length))
     {
-        unifying_receive_entry_destroy(*receive_entry);
+        unifying_ring_buffer_pop_front(state->receive_buffer);
         return UNIFYING_CHECKSUM_ERROR;
     }
 
     if(length && (*receive_entry)->length != length)
     {
-        unifying_receive_entry_destroy(*receive_entry);
+        unifying_ring_buffer_pop_front(state->receive_buffer);
         return UNIFYING_PAYLOAD_LENGTH_ERROR;
     }
 
@@ -148,68 +181,362 @@ static enum unifying_error unifying_response(struct unifying_state* state,
 }
 
 /*!
- * Dequeue a response payload and queue a HID++ payload for transmission.
+ * Pack a short HID++ 1.0 response.
+ * 
+ * \param[out]  response    Byte array that is at least \ref UNIFYING_HIDPP_1_0_SHORT_LEN bytes long.
+ * \param[in]   index       Device index copied from the request.
+ * \param[in]   sub_id      HID++ 1.0 SubID.
+ * \param[in]   params      \ref UNIFYING_HIDPP_1_0_SHORT_PARAMS_LEN bytes of HID++ parameters.
+ * 
+ * \return  Length of \p response.
+ */
+static uint8_t unifying_hidpp_1_0_short_response(uint8_t response[UNIFYING_HIDPP_1_0_SHORT_LEN],
+                                                 uint8_t index,
+                                                 uint8_t sub_id,
+                                                 uint8_t params[UNIFYING_HIDPP_1_0_SHORT_PARAMS_LEN])
+{
+    struct unifying_hidpp_1_0_short hidpp_1_0_short;
+
+    unifying_hidpp_1_0_short_init(&hidpp_1_0_short, index, sub_id, params);
+    hidpp_1_0_short.report = 0x50;
+    unifying_hidpp_1_0_short_pack(response, &hidpp_1_0_short);
+    // The checksum has to cover the report byte that was changed after initialization.
+    response[UNIFYING_HIDPP_1_0_SHORT_LEN - 1] = unifying_checksum(response, UNIFYING_HIDPP_1_0_SHORT_LEN - 1);
+
+    return UNIFYING_HIDPP_1_0_SHORT_LEN;
+}
+
+/*!
+ * Pack a long HID++ 1.0 response.
  * 
- * \todo    Refactor this code to be more readable
+ * \param[out]  response    Byte array that is at least \ref UNIFYING_HIDPP_1_0_LONG_LEN bytes long.
+ * \param[in]   index       Device index copied from the request.
+ * \param[in]   sub_id      HID++ 1.0 SubID.
+ * \param[in]   params      \ref UNIFYING_HIDPP_1_0_LONG_PARAMS_LEN bytes of HID++ parameters.
  * 
- * \todo    Implement proper HID++ responses instead of responding to everything with errors.
- *          - https://drive.google.com/drive/folders/0BxbRzx7vEV7eWmgwazJ3NUFfQ28?resourcekey=0-dQ-Lx1FORQl0KAdOHQaE1A
- *          - https://docs.google.com/document/d/0BxbRzx7vEV7eNDBheWY0UHM5dEU/edit?resourcekey=0-SPDGsNiO52FX6E-mJIXYXQ#!
- *          - https://drive.google.com/file/d/0BxbRzx7vEV7eU3VfMnRuRXktZ3M/view?resourcekey=0-06JzoS5yy_4Asod95f4Ecw
+ * \return  Length of \p response.
+ */
+static uint8_t unifying_hidpp_1_0_long_response(uint8_t response[UNIFYING_HIDPP_1_0_LONG_LEN],
+                                                uint8_t index,
+                                                uint8_t sub_id,
+                                                uint8_t params[UNIFYING_HIDPP_1_0_LONG_PARAMS_LEN])
+{
+    struct unifying_hidpp_1_0_long hidpp_1_0_long;
+
+    unifying_hidpp_1_0_long_init(&hidpp_1_0_long, index, sub_id, params);
+    hidpp_1_0_long.report = 0x51;
+    unifying_hidpp_1_0_long_pack(response, &hidpp_1_0_long);
+    response[UNIFYING_HIDPP_1_0_LONG_LEN - 1] = unifying_checksum(response, UNIFYING_HIDPP_1_0_LONG_LEN - 1);
+
+    return UNIFYING_HIDPP_1_0_LONG_LEN;
+}
+
+/*!
+ * Build the response to a HID++ 1.0 register query.
  * 
- * \param[in,out]   state   Unifying state information.
+ * \param[in,out]   state           Unifying state information.
+ *                                  Setting a register writes to its \ref unifying_hidpp_1_0_register.value "value".
+ * \param[in]       request         Received request. Short requests only use the first
+ *                                  \ref UNIFYING_HIDPP_1_0_SHORT_PARAMS_LEN parameters.
+ * \param[in]       request_length  Length of the received request.
+ * \param[out]      response        Byte array that is at least \ref UNIFYING_HIDPP_1_0_LONG_LEN bytes long.
  * 
- * \return  \ref UNIFYING_PAYLOAD_LENGTH_ERROR if the received payload is too short.
- * \return  \ref UNIFYING_CREATE_ERROR if dynamic memory allocation fails.
- * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the transmit buffer is full.
+ * \return  Length of \p response.
+ */
+static uint8_t unifying_hidpp_1_0_register_response(struct unifying_state* state,
+                                                    const struct unifying_hidpp_1_0_long* request,
+                                                    uint8_t request_length,
+                                                    uint8_t response[UNIFYING_HIDPP_1_0_LONG_LEN])
+{
+    const struct unifying_hidpp_1_0_register* hidpp_register = unifying_state_hidpp_register(state, request->params[0]);
+    uint8_t params[UNIFYING_HIDPP_1_0_LONG_PARAMS_LEN] = {0};
+    uint8_t error = UNIFYING_HIDPP_1_0_ERROR_SUCCESS;
+    bool long_register = false;
+    bool set = false;
+
+    // Successful responses repeat the register address.
+    params[0] = request->params[0];
+
+    switch(request->sub_id)
+    {
+    case UNIFYING_HIDPP_1_0_SUB_ID_GET_REGISTER:
+        break;
+    case UNIFYING_HIDPP_1_0_SUB_ID_SET_REGISTER:
+        set = true;
+        break;
+    case UNIFYING_HIDPP_1_0_SUB_ID_GET_LONG_REGISTER:
+        long_register = true;
+        break;
+    case UNIFYING_HIDPP_1_0_SUB_ID_SET_LONG_REGISTER:
+        long_register = true;
+        set = true;
+        break;
+    default:
+        error = UNIFYING_HIDPP_1_0_ERROR_INVALID_SUBID;
+        break;
+    }
+
+    if(!error && (!hidpp_register || hidpp_register->long_register != long_register))
+    {
+        error = UNIFYING_HIDPP_1_0_ERROR_INVALID_ADDRESS;
+    }
+    else if(!error && set && !hidpp_register->writable)
+    {
+        error = UNIFYING_HIDPP_1_0_ERROR_REQUEST_UNAVAILABLE;
+    }
+    else if(!error && set && long_register && request_length != UNIFYING_HIDPP_1_0_LONG_LEN)
+    {
+        // A long register can only be set by a long request.
+        error = UNIFYING_HIDPP_1_0_ERROR_INVALID_PARAM_VALUE;
+    }
+
+    if(error)
+    {
+        // Error responses describe the request that failed.
+        params[0] = request->sub_id;
+        params[1] = request->params[0];
+        params[2] = error;
+        return unifying_hidpp_1_0_short_response(response,
+                                                 request->index,
+                                                 UNIFYING_HIDPP_1_0_SUB_ID_ERROR_MSG,
+                                                 params);
+    }
+
+    uint8_t value_length = long_register ? UNIFYING_HIDPP_1_0_LONG_REGISTER_LEN : UNIFYING_HIDPP_1_0_SHORT_REGISTER_LEN;
+
+    if(set)
+    {
+        memcpy(hidpp_register->value, &request->params[1], value_length);
+        return unifying_hidpp_1_0_short_response(response, request->index, request->sub_id, params);
+    }
+
+    memcpy(&params[1], hidpp_register->value, value_length);
+
+    if(long_register)
+    {
+        return unifying_hidpp_1_0_long_response(response, request->index, request->sub_id, params);
+    }
+
+    return unifying_hidpp_1_0_short_response(response, request->index, request->sub_id, params);
+}
+
+/*!
+ * Build the response to a HID++ 2.0 query.
+ * 
+ * Features are found by feature index in \ref unifying_state.hidpp_features "state.hidpp_features".
+ * 
+ * \param[in]   state       Unifying state information.
+ * \param[in]   request     Received request. The HID++ 1.0 SubID is the HID++ 2.0 feature index.
+ * \param[out]  response    Byte array that is at least \ref UNIFYING_HIDPP_1_0_LONG_LEN bytes long.
+ * 
+ * \return  Length of \p response.
+ */
+static uint8_t unifying_hidpp_2_0_response(const struct unifying_state* state,
+                                           const struct unifying_hidpp_1_0_long* request,
+                                           uint8_t response[UNIFYING_HIDPP_1_0_LONG_LEN])
+{
+    const struct unifying_hidpp_2_0_feature* feature = NULL;
+    uint8_t params[UNIFYING_HIDPP_1_0_LONG_PARAMS_LEN] = {0};
+    // The function ID is in the high nibble and the software ID, which is echoed back, is in the low nibble.
+    uint8_t function = request->params[0] >> 4;
+    uint8_t* data = &params[1];
+    uint8_t error = 0;
+
+    params[0] = request->params[0];
+
+    if(request->sub_id < state->hidpp_features_len)
+    {
+        feature = &state->hidpp_features[request->sub_id];
+    }
+
+    if(!feature)
+    {
+        error = UNIFYING_HIDPP_2_0_ERROR_INVALID_FEATURE_INDEX;
+    }
+    else if(feature->id == UNIFYING_HIDPP_2_0_FEATURE_ROOT && function == 0)
+    {
+        // getFeature(featureId). Feature index 0 means the feature isn't supported.
+        uint16_t id = ((uint16_t) request->params[1] << 8) | request->params[2];
+
+        for(uint8_t i = 0; i < state->hidpp_features_len; i++)
+        {
+            if(state->hidpp_features[i].id == id)
+            {
+                data[0] = i;
+                data[1] = state->hidpp_features[i].type;
+                data[2] = state->hidpp_features[i].version;
+                break;
+            }
+        }
+    }
+    else if(feature->id == UNIFYING_HIDPP_2_0_FEATURE_ROOT && function == 1)
+    {
+        // getProtocolVersion(0, 0, pingData)
+        data[0] = UNIFYING_HIDPP_2_0_PROTOCOL_MAJOR;
+        data[1] = UNIFYING_HIDPP_2_0_PROTOCOL_MINOR;
+        data[2] = request->params[3];
+    }
+    else if(feature->id == UNIFYING_HIDPP_2_0_FEATURE_FEATURE_SET && function == 0)
+    {
+        // getCount() doesn't count the root feature.
+        data[0] = state->hidpp_features_len - 1;
+    }
+    else if(feature->id == UNIFYING_HIDPP_2_0_FEATURE_FEATURE_SET && function == 1)
+    {
+        // getFeatureID(featureIndex)
+        uint8_t index = request->params[1];
+
+        if(index < state->hidpp_features_len)
+        {
+            data[0] = state->hidpp_features[index].id >> 8;
+            data[1] = state->hidpp_features[index].id & 0xFF;
+            data[2] = state->hidpp_features[index].type;
+            data[3] = state->hidpp_features[index].version;
+        }
+        else
+        {
+            error = UNIFYING_HIDPP_2_0_ERROR_INVALID_ARGUMENT;
+        }
+    }
+    else if(function < feature->functions_len)
+    {
+        memcpy(data, feature->responses[function], UNIFYING_HIDPP_2_0_RESPONSE_LEN);
+    }
+    else
+    {
+        error = UNIFYING_HIDPP_2_0_ERROR_INVALID_FUNCTION_ID;
+    }
+
+    if(error)
+    {
+        params[0] = request->sub_id;
+        params[1] = request->params[0];
+        params[2] = error;
+        return unifying_hidpp_1_0_long_response(response,
+                                                request->index,
+                                                UNIFYING_HIDPP_2_0_ERROR_FEATURE_INDEX,
+                                                params);
+    }
+
+    return unifying_hidpp_1_0_long_response(response, request->index, request->sub_id, params);
+}
+
+/*!
+ * Respond to a received payload with a HID++ payload.
+ * 
+ * The response is transmitted immediately rather than queued in
+ * \ref unifying_state.transmit_buffer "state.transmit_buffer"
+ * so that unifying_tick() never adds to that buffer.
+ * The received payload stays buffered until the response has been transmitted.
+ * 
+ * HID++ 1.0 register queries are answered from the registers set by unifying_state_hidpp_registers_set().
+ * Queries with a SubID below \ref UNIFYING_HIDPP_1_0_SUB_ID_SET_REGISTER are HID++ 2.0 queries,
+ * and are answered from the features added by unifying_state_hidpp_feature_add().
+ * 
+ * \see https://drive.google.com/drive/folders/0BxbRzx7vEV7eWmgwazJ3NUFfQ28?resourcekey=0-dQ-Lx1FORQl0KAdOHQaE1A
+ * \see https://docs.google.com/document/d/0BxbRzx7vEV7eNDBheWY0UHM5dEU/edit?resourcekey=0-SPDGsNiO52FX6E-mJIXYXQ#!
+ * \see https://drive.google.com/file/d/0BxbRzx7vEV7eU3VfMnRuRXktZ3M/view?resourcekey=0-06JzoS5yy_4Asod95f4Ecw
+ * 
+ * If the response fails to transmit, it is retried after \ref UNIFYING_HIDPP_RETRY_INTERVAL
+ * rather than on every tick. See unifying_hidpp_due().
+ * 
+ * \param[in,out]   state           Unifying state information.
+ * \param[in]       current_time    Time returned by \ref unifying_interface.time "state.interface.time".
+ * 
+ * \return  \ref UNIFYING_BUFFER_EMPTY_ERROR if \ref unifying_state.receive_buffer "state.receive_buffer"
+ *          is empty.
+ * \return  \ref UNIFYING_CHECKSUM_ERROR if the received payload's computed checksum
+ *          does not match its stated checksum.
+ * \return  \ref UNIFYING_PAYLOAD_LENGTH_ERROR if the received payload is neither a short nor a long HID++ payload.
+ * \return  \ref UNIFYING_TRANSMIT_ERROR if transmission failed.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  */
-static enum unifying_error unifying_hidpp_1_0(struct unifying_state* state)
+static enum unifying_error unifying_hidpp(struct unifying_state* state, uint32_t current_time)
 {
     enum unifying_error err;
     struct unifying_receive_entry* receive_entry;
-    struct unifying_transmit_entry* transmit_entry;
     struct unifying_hidpp_1_0_short hidpp_1_0_short;
+    struct unifying_hidpp_1_0_long request;
+    uint8_t response[UNIFYING_HIDPP_1_0_LONG_LEN];
+    uint8_t response_length;
 
-    err = unifying_response(state, &receive_entry, 0);
+    receive_entry = unifying_ring_buffer_peek_front(state->receive_buffer);
 
-    if(err)
+    if(!receive_entry)
     {
-        return err;
+        return UNIFYING_BUFFER_EMPTY_ERROR;
     }
 
-    if(receive_entry->length < 4)
+    if(unifying_checksum_verify(receive_entry->payload, receive_entry->length))
     {
-        unifying_receive_entry_destroy(receive_entry);
-        return UNIFYING_PAYLOAD_LENGTH_ERROR;
+        unifying_ring_buffer_pop_front(state->receive_buffer);
+        return UNIFYING_CHECKSUM_ERROR;
     }
 
-    transmit_entry = unifying_transmit_entry_create(UNIFYING_HIDPP_1_0_SHORT_LEN, state->default_timeout);
-
-    if(!transmit_entry)
+    if(receive_entry->length == UNIFYING_HIDPP_1_0_LONG_LEN)
+    {
+        unifying_hidpp_1_0_long_unpack(&request, receive_entry->payload);
+    }
+    else if(receive_entry->length == UNIFYING_HIDPP_1_0_SHORT_LEN)
+    {
+        // Short and long payloads only differ in the number of parameters.
+        unifying_hidpp_1_0_short_unpack(&hidpp_1_0_short, receive_entry->payload);
+        memset(&request, 0, sizeof(request));
+        request.report = hidpp_1_0_short.report;
+        request.index = hidpp_1_0_short.index;
+        request.sub_id = hidpp_1_0_short.sub_id;
+        memcpy(request.params, hidpp_1_0_short.params, UNIFYING_HIDPP_1_0_SHORT_PARAMS_LEN);
+    }
+    else
     {
-        unifying_receive_entry_destroy(receive_entry);
-        return UNIFYING_CREATE_ERROR;
+        unifying_ring_buffer_pop_front(state->receive_buffer);
+        return UNIFYING_PAYLOAD_LENGTH_ERROR;
     }
 
-    receive_entry->payload[5] = UNIFYING_HIDPP_1_0_ERROR_INVALID_SUBID;
-    receive_entry->payload[6] = 0x00;
-    unifying_hidpp_1_0_short_init(&hidpp_1_0_short,
-                                  receive_entry->payload[2], // index
-                                  UNIFYING_HIDPP_1_0_SUB_ID_ERROR_MSG,
-                                  &receive_entry->payload[3]);
-    hidpp_1_0_short.report = 0x50;
-    unifying_receive_entry_destroy(receive_entry);
-    unifying_hidpp_1_0_short_pack(transmit_entry->payload, &hidpp_1_0_short);
+    if(request.sub_id < UNIFYING_HIDPP_1_0_SUB_ID_SET_REGISTER)
+    {
+        response_length = unifying_hidpp_2_0_response(state, &request, response);
+    }
+    else
+    {
+        response_length = unifying_hidpp_1_0_register_response(state, &request, receive_entry->length, response);
+    }
 
-    err = unifying_ring_buffer_push_back(state->transmit_buffer, transmit_entry);
+    // Responses aren't input, so they leave a timeout raised by the idle ladder in place.
+    err = unifying_transmit(state, response, response_length, UNIFYING_TIMEOUT_UNCHANGED);
 
     if(err)
     {
-        unifying_transmit_entry_destroy(transmit_entry);
+        // Keep the received payload so that we can respond again later.
+        // Setting a register again with the same value is harmless.
+        // Each failure also hops channels, so back off instead of retrying on every tick.
+        if(state->hidpp_failures < 5)
+        {
+            state->hidpp_failures++;
+        }
+
+        uint32_t interval = (uint32_t) UNIFYING_HIDPP_RETRY_INTERVAL * UNIFYING_TIME_TICKS_PER_MS;
+        state->hidpp_retry = current_time + (interval << (state->hidpp_failures - 1));
+        return err;
     }
 
-    return err;
+    state->hidpp_failures = 0;
+    unifying_ring_buffer_pop_front(state->receive_buffer);
+    return UNIFYING_SUCCESS;
+}
+
+/*!
+ * Check if a buffered HID++ query may be answered.
+ * 
+ * \param[in]   state           Unifying state information.
+ * \param[in]   current_time    Time returned by \ref unifying_interface.time "state.interface.time".
+ * 
+ * \return  `true` if the query hasn't been answered yet, or if its failed response is due to be retried.
+ * \return  `false` otherwise.
+ */
+static bool unifying_hidpp_due(const struct unifying_state* state, uint32_t current_time)
+{
+    return !state->hidpp_failures || unifying_time_reached(current_time, state->hidpp_retry);
 }
 
 /*!
@@ -223,8 +550,7 @@ static enum unifying_error unifying_hidpp_1_0(struct unifying_state* state)
  * \param[in]       device_type     Values indicating the device type.
  *                                  Valid values and their meaning are not yet documented.
  * 
- * \return  \ref UNIFYING_CREATE_ERROR if dynamic memory allocation fails.
- * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the transmit buffer is full.
+ * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the control buffer is full.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  */
 static enum unifying_error unifying_pair_step_1(struct unifying_state* state,
@@ -232,28 +558,22 @@ static enum unifying_error unifying_pair_step_1(struct unifying_state* state,
                                                 uint16_t product_id,
                                                 uint16_t device_type)
 {
-    enum unifying_error err;
     struct unifying_transmit_entry* transmit_entry;
     struct unifying_pair_request_1 pair_request;
 
-    transmit_entry = unifying_transmit_entry_create(UNIFYING_PAIR_REQUEST_1_LEN, state->default_timeout);
+    transmit_entry = unifying_ring_buffer_reserve_back(&state->control_buffer);
 
     if(!transmit_entry)
     {
-        return UNIFYING_CREATE_ERROR;
+        return UNIFYING_BUFFER_FULL_ERROR;
     }
 
+    unifying_transmit_entry_init(transmit_entry, UNIFYING_PAIR_REQUEST_1_LEN, state->default_timeout);
     unifying_pair_request_1_init(&pair_request, id, state->timeout, product_id, device_type);
     unifying_pair_request_1_pack(transmit_entry->payload, &pair_request);
+    unifying_ring_buffer_commit_back(&state->control_buffer);
 
-    err = unifying_ring_buffer_push_back(state->transmit_buffer, transmit_entry);
-
-    if(err)
-    {
-        unifying_transmit_entry_destroy(transmit_entry);
-    }
-
-    return err;
+    return UNIFYING_SUCCESS;
 }
 
 /*!
@@ -264,8 +584,7 @@ static enum unifying_error unifying_pair_step_1(struct unifying_state* state,
  * \param[in]       serial          Serial number of your device. The exact value does not matter.
  * \param[in]       capabilities    HID++ capabilities.
  * 
- * \return  \ref UNIFYING_CREATE_ERROR if dynamic memory allocation fails.
- * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the transmit buffer is full.
+ * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the control buffer is full.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  */
 static enum unifying_error unifying_pair_step_2(struct unifying_state* state,
@@ -273,28 +592,22 @@ static enum unifying_error unifying_pair_step_2(struct unifying_state* state,
                                                 uint32_t serial,
                                                 uint16_t capabilities)
 {
-    enum unifying_error err;
     struct unifying_transmit_entry* transmit_entry;
     struct unifying_pair_request_2 pair_request;
 
-    transmit_entry = unifying_transmit_entry_create(UNIFYING_PAIR_REQUEST_2_LEN, state->default_timeout);
+    transmit_entry = unifying_ring_buffer_reserve_back(&state->control_buffer);
 
     if(!transmit_entry)
     {
-        return UNIFYING_CREATE_ERROR;
+        return UNIFYING_BUFFER_FULL_ERROR;
     }
 
+    unifying_transmit_entry_init(transmit_entry, UNIFYING_PAIR_REQUEST_2_LEN, state->default_timeout);
     unifying_pair_request_2_init(&pair_request, crypto, serial, capabilities);
     unifying_pair_request_2_pack(transmit_entry->payload, &pair_request);
+    unifying_ring_buffer_commit_back(&state->control_buffer);
 
-    err = unifying_ring_buffer_push_back(state->transmit_buffer, transmit_entry);
-
-    if(err)
-    {
-        unifying_transmit_entry_destroy(transmit_entry);
-    }
-
-    return err;
+    return UNIFYING_SUCCESS;
 }
 
 /*!
@@ -309,36 +622,29 @@ static enum unifying_error unifying_pair_step_2(struct unifying_state* state,
  *                                  The name length does not include a NULL terminator.
  *                                  The name cannot be longer than \ref UNIFYING_MAX_NAME_LEN.
  * 
- * \return  \ref UNIFYING_CREATE_ERROR if dynamic memory allocation fails.
- * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the transmit buffer is full.
+ * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the control buffer is full.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  */
 static enum unifying_error unifying_pair_step_3(struct unifying_state* state,
                                                 const char* name,
                                                 uint8_t name_length)
 {
-    enum unifying_error err;
     struct unifying_transmit_entry* transmit_entry;
     struct unifying_pair_request_3 pair_request;
 
-    transmit_entry = unifying_transmit_entry_create(UNIFYING_PAIR_REQUEST_3_LEN, state->default_timeout);
+    transmit_entry = unifying_ring_buffer_reserve_back(&state->control_buffer);
 
     if(!transmit_entry)
     {
-        return UNIFYING_CREATE_ERROR;
+        return UNIFYING_BUFFER_FULL_ERROR;
     }
 
+    unifying_transmit_entry_init(transmit_entry, UNIFYING_PAIR_REQUEST_3_LEN, state->default_timeout);
     unifying_pair_request_3_init(&pair_request, name, name_length);
     unifying_pair_request_3_pack(transmit_entry->payload, &pair_request);
+    unifying_ring_buffer_commit_back(&state->control_buffer);
 
-    err = unifying_ring_buffer_push_back(state->transmit_buffer, transmit_entry);
-
-    if(err)
-    {
-        unifying_transmit_entry_destroy(transmit_entry);
-    }
-
-    return err;
+    return UNIFYING_SUCCESS;
 }
 
 /*!
@@ -346,388 +652,806 @@ static enum unifying_error unifying_pair_step_3(struct unifying_state* state,
  * 
  * \param[in,out]   state           Unifying state information.
  * 
- * \return  \ref UNIFYING_CREATE_ERROR if dynamic memory allocation fails.
- * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the transmit buffer is full.
+ * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the control buffer is full.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  */
 static enum unifying_error unifying_pair_complete(struct unifying_state* state)
 {
-    enum unifying_error err;
     struct unifying_transmit_entry* transmit_entry;
     struct unifying_pair_complete_request pair_request;
 
-    transmit_entry = unifying_transmit_entry_create(UNIFYING_PAIR_COMPLETE_REQUEST_LEN, state->default_timeout);
+    transmit_entry = unifying_ring_buffer_reserve_back(&state->control_buffer);
 
     if(!transmit_entry)
     {
-        return UNIFYING_CREATE_ERROR;
+        return UNIFYING_BUFFER_FULL_ERROR;
     }
 
+    unifying_transmit_entry_init(transmit_entry, UNIFYING_PAIR_COMPLETE_REQUEST_LEN, state->default_timeout);
     unifying_pair_complete_request_init(&pair_request);
     unifying_pair_complete_request_pack(transmit_entry->payload, &pair_request);
+    unifying_ring_buffer_commit_back(&state->control_buffer);
 
-    err = unifying_ring_buffer_push_back(state->transmit_buffer, transmit_entry);
-
-    if(err)
-    {
-        unifying_transmit_entry_destroy(transmit_entry);
-    }
-
-    return err;
+    return UNIFYING_SUCCESS;
 }
 
 /*!
- * Queue a keep-alive payload.
+ * Transmit a keep-alive payload.
  * 
  * \todo remove \p timeout and use \ref unifying_state.timeout "state.timeout" instead.
  * 
  * \param[in,out]   state       Unifying state information.
  * \param[in]       timeout     Current packet timeout.
  * 
- * \return  \ref UNIFYING_CREATE_ERROR if dynamic memory allocation fails.
- * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the transmit buffer is full.
+ * \return  \ref UNIFYING_TRANSMIT_ERROR if transmission failed.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  */
 static enum unifying_error unifying_keep_alive(struct unifying_state* state, uint16_t timeout)
 {
-    enum unifying_error err;
-    struct unifying_transmit_entry* transmit_entry;
+    uint8_t payload[UNIFYING_KEEP_ALIVE_REQUEST_LEN];
     struct unifying_keep_alive_request keep_alive_request;
 
-    transmit_entry = unifying_transmit_entry_create(UNIFYING_KEEP_ALIVE_REQUEST_LEN, 0);
-
-    if(!transmit_entry)
-    {
-        return UNIFYING_CREATE_ERROR;
-    }
-
     unifying_keep_alive_request_init(&keep_alive_request, timeout);
-    unifying_keep_alive_request_pack(transmit_entry->payload, &keep_alive_request);
-
-    err = unifying_ring_buffer_push_back(state->transmit_buffer, transmit_entry);
+    unifying_keep_alive_request_pack(payload, &keep_alive_request);
 
-    if(err)
-    {
-        unifying_transmit_entry_destroy(transmit_entry);
-    }
-
-    return err;
+    return unifying_transmit(state, payload, UNIFYING_KEEP_ALIVE_REQUEST_LEN, UNIFYING_TIMEOUT_UNCHANGED);
 }
 
-enum unifying_error unifying_tick(struct unifying_state* state)
+/*!
+ * Transmit a payload while nothing else is queued.
+ * 
+ * If the next step of the \ref unifying_state.idle_ladder "idle timeout ladder" is due then
+ * a set timeout payload is transmitted to raise the timeout.
+ * Otherwise a keep-alive payload is transmitted.
+ * While pairing, the ladder is paused so that pairing responses are polled at the default timeout.
+ * 
+ * \param[in,out]   state           Unifying state information.
+ * \param[in]       current_time    Time returned by \ref unifying_interface.time "state.interface.time".
+ * 
+ * \return  \ref UNIFYING_TRANSMIT_ERROR if transmission failed.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+static enum unifying_error unifying_idle(struct unifying_state* state, uint32_t current_time)
 {
-    uint32_t current_time = state->interface->time();
-
-    // Handle edge case where next_transmit has overflowed but the current_time hasn't.
-    if(state->previous_transmit > state->next_transmit && current_time > state->previous_transmit)
-    {
-        return UNIFYING_SUCCESS;
-    }
-
-    if((current_time >= state->next_transmit) ||
-       // Handle edge case where current_time has overflowed but the next_transmit hasn't.
-       (state->previous_transmit > current_time && state->next_transmit > current_time))
+    if(!state->pairing.step && state->idle_step < state->idle_ladder_len)
     {
+        const struct unifying_idle_step* step = &state->idle_ladder[state->idle_step];
+        uint32_t step_time = state->last_activity + step->idle_time * UNIFYING_TIME_TICKS_PER_MS;
 
-        if(!unifying_ring_buffer_empty(state->receive_buffer))
-        {
-            // We have received a payload that hasn't been handled yet.
-            // It should be a HID++ query so we'll queue a HID++ response.
-            // TODO: Consider handling HID++ queries outside of the transmit interval.
-            unifying_hidpp_1_0(state);
-        }
-        else if(unifying_ring_buffer_empty(state->transmit_buffer))
+        if(unifying_time_reached(current_time, step_time))
         {
-            // No payloads are queued for transmission so we'll queue a keep alive packet.
-            unifying_keep_alive(state, state->timeout);
-        }
+            enum unifying_error err;
+            uint8_t payload[UNIFYING_SET_TIMEOUT_REQUEST_LEN];
+            struct unifying_set_timeout_request timeout_request;
 
-        // Get a payload and transmit it
-        struct unifying_transmit_entry* transmit_entry;
-        transmit_entry = unifying_ring_buffer_peek_front(state->transmit_buffer);
+            unifying_set_timeout_request_init(&timeout_request, step->timeout);
+            unifying_set_timeout_request_pack(payload, &timeout_request);
 
-        if(!transmit_entry)
-        {
-            // The buffer appears to be empty even though we checked and queued data if it was empty.
-            // This should never happen.
-            return UNIFYING_BUFFER_EMPTY_ERROR;
-        }
+            err = unifying_transmit(state, payload, UNIFYING_SET_TIMEOUT_REQUEST_LEN, step->timeout);
 
-        enum unifying_error err;
-        err = unifying_transmit(state,
-                                transmit_entry->payload,
-                                transmit_entry->length,
-                                transmit_entry->timeout);
+            if(!err)
+            {
+                state->idle_step++;
+            }
 
-        if(err)
-        {
-            // Transmission failed.
-            // Keep the payload queued for re-transmission.
             return err;
         }
-
-        // Dequeue and destroy the transmit entry since we won't need it anymore.
-        unifying_transmit_entry_destroy(unifying_ring_buffer_pop_front(state->transmit_buffer));
-
-        if(state->interface->payload_available()) {
-            return unifying_receive(state);
-        }
     }
 
-    return UNIFYING_SUCCESS;
+    return unifying_keep_alive(state, state->timeout);
 }
 
-enum unifying_error unifying_loop(struct unifying_state* state,
-                                  bool exit_on_error,
-                                  bool exit_on_transmit,
-                                  bool exit_on_receive)
+/*!
+ * Check if any queued payload is waiting to be transmitted.
+ * 
+ * \param[in]   state   Unifying state information.
+ * 
+ * \return  `true` if \ref unifying_state.transmit_buffer "state.transmit_buffer" or
+ *          \ref unifying_state.control_buffer "state.control_buffer" is not empty.
+ * \return  `false` otherwise.
+ */
+static bool unifying_transmit_pending(const struct unifying_state* state)
 {
-    enum unifying_error err = UNIFYING_SUCCESS;
+    return !unifying_ring_buffer_empty(state->transmit_buffer) ||
+           !unifying_ring_buffer_empty(&state->control_buffer);
+}
 
-    while(true)
-    {
-        if(exit_on_error && err)
-        {
-            // Some error occurred.
-            break;
-        }
+/*!
+ * Transmit the payload at the front of a transmit lane.
+ * 
+ * The payload is only removed from the lane if it was transmitted successfully.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ * \param[in,out]   lane    Non-empty ring buffer of \ref unifying_transmit_entry structures.
+ * 
+ * \return  \ref UNIFYING_TRANSMIT_ERROR if transmission failed.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+static enum unifying_error unifying_transmit_front(struct unifying_state* state, struct unifying_ring_buffer* lane)
+{
+    enum unifying_error err;
+    struct unifying_transmit_entry* transmit_entry;
+
+    transmit_entry = unifying_ring_buffer_peek_front(lane);
+
+    err = unifying_transmit(state,
+                            transmit_entry->payload,
+                            transmit_entry->length,
+                            transmit_entry->timeout);
+
+    if(!err)
+    {
+        // Dequeue the transmit entry since we won't need it anymore.
+        // Failed transmissions keep the payload queued for re-transmission.
+        unifying_ring_buffer_pop_front(lane);
+    }
+
+    return err;
+}
+
+/*!
+ * Check if a transmit entry holds a mouse payload.
+ * 
+ * \param[in]   transmit_entry  Transmit entry to check. May be `NULL`.
+ * 
+ * \return  `true` if \p transmit_entry was queued by unifying_mouse().
+ * \return  `false` otherwise.
+ */
+static bool unifying_mouse_entry(const struct unifying_transmit_entry* transmit_entry)
+{
+    return transmit_entry &&
+           transmit_entry->length == UNIFYING_MOUSE_REQUEST_LEN &&
+           transmit_entry->payload[1] == 0xC2;
+}
+
+/*!
+ * Merge mouse payloads at the front of the transmit buffer.
+ * 
+ * While the first two payloads are mouse payloads with the same buttons,
+ * the movement of the first is added to the second and the first is dropped.
+ * Payloads are only merged if the sum still fits in a single mouse payload,
+ * so no movement is ever lost and button changes keep their order.
+ * 
+ * Only the consumer of the transmit buffer may call this,
+ * since it modifies payloads that have already been queued.
+ * 
+ * \param[in,out]   transmit_buffer     Ring buffer of \ref unifying_transmit_entry structures.
+ */
+static void unifying_mouse_coalesce(struct unifying_ring_buffer* transmit_buffer)
+{
+    struct unifying_transmit_entry* front = unifying_ring_buffer_peek_front(transmit_buffer);
+    struct unifying_transmit_entry* next;
+    struct unifying_mouse_request front_request;
+    struct unifying_mouse_request next_request;
+
+    while(unifying_mouse_entry(front))
+    {
+        next = unifying_ring_buffer_peek_at(transmit_buffer, 1);
 
-        if(exit_on_transmit && unifying_ring_buffer_empty(state->transmit_buffer))
+        if(!unifying_mouse_entry(next))
         {
-            // Transmit buffer empty.
             break;
         }
 
-        if(exit_on_receive && !unifying_ring_buffer_empty(state->receive_buffer))
+        unifying_mouse_request_unpack(&front_request, front->payload);
+        unifying_mouse_request_unpack(&next_request, next->payload);
+
+        int16_t move_y = front_request.move_y + next_request.move_y;
+        int16_t move_x = front_request.move_x + next_request.move_x;
+        int16_t wheel_y = front_request.wheel_y + next_request.wheel_y;
+        int16_t wheel_x = front_request.wheel_x + next_request.wheel_x;
+
+        if(front_request.buttons != next_request.buttons ||
+           move_y != unifying_int12_clamp(move_y) ||
+           move_x != unifying_int12_clamp(move_x) ||
+           wheel_y < INT8_MIN || wheel_y > INT8_MAX ||
+           wheel_x < INT8_MIN || wheel_x > INT8_MAX)
         {
-            // Payload received.
             break;
         }
 
-        err = unifying_tick(state);
+        unifying_mouse_request_init(&next_request, next_request.buttons, move_y, move_x, wheel_y, wheel_x);
+        unifying_mouse_request_pack(next->payload, &next_request);
+        unifying_ring_buffer_pop_front(transmit_buffer);
+        front = next;
     }
-
-    return err;
 }
 
-enum unifying_error unifying_pair(struct unifying_state* state,
-                                  uint8_t id,
-                                  uint16_t product_id,
-                                  uint16_t device_type,
-                                  uint32_t crypto,
-                                  uint32_t serial,
-                                  uint16_t capabilities,
-                                  const char* name,
-                                  uint8_t name_length)
+/*!
+ * Check if the next transmission is due.
+ * 
+ * \param[in]   state           Unifying state information.
+ * \param[in]   current_time    Time returned by \ref unifying_interface.time "state.interface.time".
+ * 
+ * \return  `true` if unifying_tick() should transmit at \p current_time.
+ * \return  `false` otherwise.
+ */
+static bool unifying_transmit_due(const struct unifying_state* state, uint32_t current_time)
 {
-    enum unifying_error err = UNIFYING_SUCCESS;
-    struct unifying_receive_entry* receive_entry;
-
-    // Unifying appears to only support 16 character names.
-    if(name_length > UNIFYING_MAX_NAME_LEN)
+    if(state->idle_step && unifying_transmit_pending(state))
     {
-        return UNIFYING_NAME_LENGTH_ERROR;
+        // The idle timeout ladder has raised the timeout.
+        // Don't make queued input wait for the raised timeout to elapse.
+        return true;
     }
 
-    // Pairing begins on a predetermined address.
-    if(state->interface->set_address(unifying_pairing_address))
+    return unifying_time_reached(current_time, state->next_transmit);
+}
+
+/*!
+ * Sleep until the next transmission is due.
+ * 
+ * Keystream is precomputed before sleeping since unifying_tick() won't get the chance to do it.
+ * Nothing happens if \ref unifying_interface.wait_until "state.interface.wait_until" is not set
+ * or if a transmission is already due.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ */
+static void unifying_wait(struct unifying_state* state)
+{
+    if(!state->interface->wait_until)
     {
-        return UNIFYING_SET_ADDRESS_ERROR;
+        return;
     }
 
-    // We want total control of the buffers so we'll clear them before pairing.
-    unifying_state_buffers_clear(state);
-
-    // Queue a pairing packet for transmission.
-    unifying_pair_step_1(state, id, product_id, device_type);
+    uint32_t current_time = state->interface->time();
 
-    // We don't know which channel the receiver is listening on.
-    // Try to pair on each channel until one works.
-    for(int i = 0; i < UNIFYING_CHANNELS_LEN; i++)
+    if((!unifying_ring_buffer_empty(state->receive_buffer) && unifying_hidpp_due(state, current_time)) ||
+       unifying_transmit_due(state, current_time))
     {
-        // Transmit the initial paring request.
-        err = unifying_loop(state, true, true, false);
+        return;
+    }
 
-        // If transmission fails then we'll try again on another channel.
-        if(!err)
+#if UNIFYING_KEYSTREAM_LEN
+    for(uint8_t i = 0; i < UNIFYING_KEYSTREAM_LEN; i++)
+    {
+        if(unifying_state_keystream_fill(state))
         {
-            // Success.
-            // Continue pairing.
             break;
         }
     }
+#endif
 
-    // We may have already received a payload from a previous pairing attempt.
-    // That payload is invalid so we'll just ignore it.
-    unifying_state_buffers_clear(state);
+    state->interface->wait_until(unifying_next_deadline(state));
+}
 
-    if(err)
+uint32_t unifying_next_deadline(const struct unifying_state* state)
+{
+    bool received = !unifying_ring_buffer_empty(state->receive_buffer);
+
+    if(received && !state->hidpp_failures)
     {
-        return err;
+        // HID++ queries are answered right away.
+        return state->previous_transmit;
     }
 
-
-    // Send a keep alive payload so we can receive a response.
-    err = unifying_loop(state, true, false, true);
-
-    if(err)
+    if(state->idle_step && unifying_transmit_pending(state))
     {
-        // If transmission failed then a keep alive payload is still buffered.
-        unifying_state_buffers_clear(state);
-        return err;
+        // Queued payloads are transmitted right away while the timeout is raised.
+        return state->previous_transmit;
     }
 
-    err = unifying_response(state, &receive_entry, UNIFYING_PAIR_RESPONSE_1_LEN);
-
-    if(err)
+    if(received && !unifying_time_reached(state->hidpp_retry, state->next_transmit))
     {
-        return err;
+        // A failed HID++ response is retried before the next transmission is due.
+        return state->hidpp_retry;
     }
 
-    // Unpack the response.
-    struct unifying_pair_response_1 pair_response_1;
-    unifying_pair_response_1_unpack(&pair_response_1, receive_entry->payload);
-    unifying_receive_entry_destroy(receive_entry);
+    return state->next_transmit;
+}
+
+/*!
+ * End the pairing process.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ * \param[in]       result  Result of the pairing process.
+ * 
+ * \return  \p result.
+ */
+static enum unifying_error unifying_pair_finish(struct unifying_state* state, enum unifying_error result)
+{
+    state->pairing.step = UNIFYING_PAIR_STEP_IDLE;
+    state->pairing.result = result;
 
-    // Check that we got the correct response to our pairing request.
-    if(pair_response_1.step != 1)
+    if(result)
     {
-        return UNIFYING_PAIR_STEP_ERROR;
+        // A pairing request or keep alive payload may still be buffered.
+        unifying_state_buffers_clear(state);
     }
 
-    // Check that the response was intended for us.
-    if(id != pair_response_1.id)
+    return result;
+}
+
+/*!
+ * Handle the pairing response that the current pairing step is waiting for,
+ * and queue the next pairing request.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ *                          \ref unifying_state.receive_buffer "state.receive_buffer" must not be empty.
+ * 
+ * \return  \ref UNIFYING_PAIR_STEP_ERROR if the response is for an unexpected step.
+ * \return  \ref UNIFYING_PAIR_ID_ERROR if the response was intended for another device.
+ * \return  \ref UNIFYING_SET_ADDRESS_ERROR if the new RF address could not be set.
+ * \return  Any error returned by unifying_response().
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+static enum unifying_error unifying_pair_response(struct unifying_state* state)
+{
+    enum unifying_error err;
+    struct unifying_receive_entry* receive_entry;
+    struct unifying_pairing* pairing = &state->pairing;
+
+    if(pairing->step == UNIFYING_PAIR_STEP_RESPONSE_1)
     {
-        return UNIFYING_PAIR_ID_ERROR;
+        err = unifying_response(state, &receive_entry, UNIFYING_PAIR_RESPONSE_1_LEN);
+
+        if(err)
+        {
+            return err;
+        }
+
+        struct unifying_pair_response_1 pair_response_1;
+        unifying_pair_response_1_unpack(&pair_response_1, receive_entry->payload);
+        unifying_ring_buffer_pop_front(state->receive_buffer);
+
+        // Check that we got the correct response to our pairing request.
+        if(pair_response_1.step != 1)
+        {
+            return UNIFYING_PAIR_STEP_ERROR;
+        }
+
+        // Check that the response was intended for us.
+        if(pairing->id != pair_response_1.id)
+        {
+            return UNIFYING_PAIR_ID_ERROR;
+        }
+
+        // We've received a new address for all future communication with the receiver.
+        if(unifying_state_address_set(state, pair_response_1.address))
+        {
+            return UNIFYING_SET_ADDRESS_ERROR;
+        }
+
+        pairing->receiver_product_id = pair_response_1.product_id;
+        pairing->step = UNIFYING_PAIR_STEP_REQUEST_2;
+        return unifying_pair_step_2(state, pairing->crypto, pairing->serial, pairing->capabilities);
     }
 
-    // We've received a new address for all future communication with the receiver.
-    if(unifying_state_address_set(state, pair_response_1.address))
+    if(pairing->step == UNIFYING_PAIR_STEP_RESPONSE_2)
     {
-        return UNIFYING_SET_ADDRESS_ERROR;
+        err = unifying_response(state, &receive_entry, UNIFYING_PAIR_RESPONSE_2_LEN);
+
+        if(err)
+        {
+            return err;
+        }
+
+        struct unifying_pair_response_2 pair_response_2;
+        unifying_pair_response_2_unpack(&pair_response_2, receive_entry->payload);
+        unifying_ring_buffer_pop_front(state->receive_buffer);
+
+        if(pair_response_2.step != 2)
+        {
+            return UNIFYING_PAIR_STEP_ERROR;
+        }
+
+        pairing->receiver_crypto = pair_response_2.crypto;
+        pairing->step = UNIFYING_PAIR_STEP_REQUEST_3;
+        return unifying_pair_step_3(state, pairing->name, pairing->name_length);
     }
 
-    err = unifying_pair_step_2(state, crypto, serial, capabilities);
+    err = unifying_response(state, &receive_entry, UNIFYING_PAIR_RESPONSE_3_LEN);
 
     if(err)
     {
         return err;
     }
 
-    // Transmit the next paring request.
-    err = unifying_loop(state, true, true, false);
+    struct unifying_pair_response_3 pair_response_3;
+    unifying_pair_response_3_unpack(&pair_response_3, receive_entry->payload);
+    unifying_ring_buffer_pop_front(state->receive_buffer);
 
-    if(err)
+    if(pair_response_3.step != 6)
     {
-        // If transmission failed then a pairing request is still buffered.
-        unifying_state_buffers_clear(state);
-        return err;
+        return UNIFYING_PAIR_STEP_ERROR;
     }
 
-    // Send a keep alive payload so we can receive a response.
-    err = unifying_loop(state, true, false, true);
+    pairing->step = UNIFYING_PAIR_STEP_COMPLETE;
+    return unifying_pair_complete(state);
+}
 
-    if(err)
+/*!
+ * Set the RF channel to the pairing channel at the current sweep position.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ * 
+ * \return  \ref UNIFYING_SET_CHANNEL_ERROR if the channel could not be set.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+static enum unifying_error unifying_pair_channel_set(struct unifying_state* state)
+{
+    struct unifying_pairing* pairing = &state->pairing;
+    uint8_t index = pairing->channel_order[pairing->sweep_position % UNIFYING_PAIRING_CHANNELS_LEN];
+
+    if(unifying_state_channel_set(state, unifying_pairing_channels[index]))
     {
-        // If transmission failed then a keep alive payload is still buffered.
-        unifying_state_buffers_clear(state);
-        return err;
+        return UNIFYING_SET_CHANNEL_ERROR;
     }
 
-    err = unifying_response(state, &receive_entry, UNIFYING_PAIR_RESPONSE_2_LEN);
+    return UNIFYING_SUCCESS;
+}
 
-    if(err)
+/*!
+ * Pick the channel to retry pairing request 1 on after it failed to transmit.
+ * 
+ * The same pairing channel is retried until \ref UNIFYING_PAIR_CHANNEL_DWELL has passed,
+ * then the next one in \ref unifying_pairing.channel_order "state.pairing.channel_order" is tried.
+ * 
+ * \param[in,out]   state           Unifying state information.
+ * \param[in]       current_time    Time returned by \ref unifying_interface.time "state.interface.time".
+ * 
+ * \return  \ref UNIFYING_TRANSMIT_ERROR if every pairing channel has been tried \ref UNIFYING_PAIR_SWEEPS times.
+ * \return  \ref UNIFYING_SET_CHANNEL_ERROR if the channel could not be set.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+static enum unifying_error unifying_pair_sweep(struct unifying_state* state, uint32_t current_time)
+{
+    struct unifying_pairing* pairing = &state->pairing;
+
+    if(unifying_time_reached(current_time, pairing->dwell_start + UNIFYING_PAIR_CHANNEL_DWELL * UNIFYING_TIME_TICKS_PER_MS))
     {
-        return err;
+        if(++pairing->sweep_position >= UNIFYING_PAIRING_CHANNELS_LEN * UNIFYING_PAIR_SWEEPS)
+        {
+            return UNIFYING_TRANSMIT_ERROR;
+        }
+
+        pairing->dwell_start = current_time;
     }
 
-    // Unpack the response.
-    struct unifying_pair_response_2 pair_response_2;
-    unifying_pair_response_2_unpack(&pair_response_2, receive_entry->payload);
-    unifying_receive_entry_destroy(receive_entry);
+    return unifying_pair_channel_set(state);
+}
+
+/*!
+ * Move the pairing channel that pairing request 1 was transmitted on to the front of
+ * \ref unifying_pairing.channel_order "state.pairing.channel_order".
+ * 
+ * \param[in,out]   state   Unifying state information.
+ */
+static void unifying_pair_channel_learn(struct unifying_state* state)
+{
+    struct unifying_pairing* pairing = &state->pairing;
+    uint8_t position = pairing->sweep_position % UNIFYING_PAIRING_CHANNELS_LEN;
+    uint8_t index = pairing->channel_order[position];
+
+    memmove(&pairing->channel_order[1], &pairing->channel_order[0], position);
+    pairing->channel_order[0] = index;
+}
+
+/*!
+ * Advance the pairing process after unifying_tick() has transmitted.
+ * 
+ * \param[in,out]   state           Unifying state information.
+ * \param[in]       current_time    Time returned by \ref unifying_interface.time "state.interface.time".
+ * \param[in]       err             Error returned while transmitting.
+ * 
+ * \return  \p err if it doesn't end the pairing process.
+ * \return  The error that ended the pairing process.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+static enum unifying_error unifying_pair_advance(struct unifying_state* state,
+                                                 uint32_t current_time,
+                                                 enum unifying_error err)
+{
+    struct unifying_pairing* pairing = &state->pairing;
 
-    // Check that we got the correct response to our pairing request.
-    if(pair_response_2.step != 2)
+    if(err)
     {
-        return UNIFYING_PAIR_STEP_ERROR;
+        // We don't know which channel the receiver is listening on.
+        // The initial request is retried across the pairing channels.
+        if(pairing->step == UNIFYING_PAIR_STEP_REQUEST_1 && err == UNIFYING_TRANSMIT_ERROR)
+        {
+            enum unifying_error sweep_err = unifying_pair_sweep(state, current_time);
+
+            if(!sweep_err)
+            {
+                return err;
+            }
+
+            err = sweep_err;
+        }
+
+        return unifying_pair_finish(state, err);
     }
 
-    err = unifying_pair_step_3(state, name, name_length);
+    switch(pairing->step)
+    {
+    case UNIFYING_PAIR_STEP_REQUEST_1:
+    case UNIFYING_PAIR_STEP_REQUEST_2:
+    case UNIFYING_PAIR_STEP_REQUEST_3:
+        if(!unifying_ring_buffer_empty(&state->control_buffer))
+        {
+            // The request hasn't been transmitted yet.
+            break;
+        }
+
+        if(pairing->step == UNIFYING_PAIR_STEP_REQUEST_1)
+        {
+            // The receiver is listening on this channel. Try it first next time.
+            unifying_pair_channel_learn(state);
+            // We may have already received a payload from a previous pairing attempt.
+            // That payload is invalid so we'll just ignore it.
+            unifying_state_receive_buffer_clear(state);
+        }
+
+        // Keep alive payloads are transmitted until the receiver responds.
+        pairing->step++;
+        pairing->deadline = current_time + UNIFYING_PAIR_RESPONSE_TIMEOUT * UNIFYING_TIME_TICKS_PER_MS;
+        break;
+    case UNIFYING_PAIR_STEP_RESPONSE_1:
+    case UNIFYING_PAIR_STEP_RESPONSE_2:
+    case UNIFYING_PAIR_STEP_RESPONSE_3:
+        if(!unifying_ring_buffer_empty(state->receive_buffer))
+        {
+            err = unifying_pair_response(state);
+
+            if(err)
+            {
+                return unifying_pair_finish(state, err);
+            }
+        }
+        else if(unifying_time_reached(current_time, pairing->deadline))
+        {
+            return unifying_pair_finish(state, UNIFYING_TIMEOUT_ERROR);
+        }
+
+        break;
+    case UNIFYING_PAIR_STEP_COMPLETE:
+        if(!unifying_ring_buffer_empty(&state->control_buffer))
+        {
+            break;
+        }
+
+        // We've received all the information that we need to create an AES key.
+        // We need to deobfuscate it.
+        struct unifying_proto_aes_key proto_aes_key;
+        unifying_proto_aes_key_init(&proto_aes_key,
+                                    state->address,
+                                    pairing->product_id,
+                                    pairing->receiver_product_id,
+                                    pairing->crypto,
+                                    pairing->receiver_crypto);
+        uint8_t aes_buffer[UNIFYING_AES_BLOCK_LEN];
+        unifying_proto_aes_key_pack(aes_buffer, &proto_aes_key);
+        unifying_deobfuscate_aes_key(state->aes_key, aes_buffer);
+        unifying_state_aes_key_changed(state);
+
+        return unifying_pair_finish(state, UNIFYING_SUCCESS);
+    case UNIFYING_PAIR_STEP_IDLE:
+        break;
+    }
+
+    return UNIFYING_SUCCESS;
+}
+
+/*!
+ * Transmit from the highest priority lane that has something to transmit.
+ * 
+ * \param[in,out]   state           Unifying state information.
+ * \param[in]       current_time    Time returned by \ref unifying_interface.time "state.interface.time".
+ * 
+ * \return  See unifying_tick().
+ */
+static enum unifying_error unifying_serve(struct unifying_state* state, uint32_t current_time)
+{
+    bool due = unifying_transmit_due(state, current_time);
+    enum unifying_error err;
+
+    // Serve the highest priority lane that has something to transmit.
+    // unifying_tick() only ever consumes from the transmit buffer.
+    // This lets another context, such as an interrupt handler, produce input payloads concurrently.
+    if(due && !unifying_ring_buffer_empty(state->transmit_buffer))
+    {
+        // Input reports come first so that they are never delayed by anything else.
+        // Mouse movement that piled up since the last transmission is sent as a single payload.
+        unifying_mouse_coalesce(state->transmit_buffer);
+        err = unifying_transmit_front(state, state->transmit_buffer);
+
+        if(!err)
+        {
+            unifying_input_transmitted(state);
+        }
+    }
+    else if(!state->pairing.step &&
+            !unifying_ring_buffer_empty(state->receive_buffer) &&
+            unifying_hidpp_due(state, current_time))
+    {
+        // We have received a payload that hasn't been handled yet.
+        // While pairing, received payloads are pairing responses instead.
+        // It should be a HID++ query so we'll respond to it.
+        // The receiver is waiting on the response so this doesn't wait for the transmit interval.
+        // Its next query comes back in the ACK payload, so enumeration runs at one query per tick.
+        err = unifying_hidpp(state, current_time);
+    }
+    else if(!due)
+    {
+        // Use the idle time to prepare keystream for future encrypted keystrokes.
+        unifying_state_keystream_fill(state);
+        return UNIFYING_SUCCESS;
+    }
+    else if(!unifying_ring_buffer_empty(&state->control_buffer))
+    {
+        // Pairing, wake up, and set timeout payloads.
+        err = unifying_transmit_front(state, &state->control_buffer);
+    }
+    else
+    {
+        // Nothing else needs transmitting so we'll transmit a keep alive packet,
+        // or raise the timeout if we've been idle for long enough.
+        // Keep alive packets are only ever built here so they never wait in front of real traffic.
+        err = unifying_idle(state, current_time);
+    }
 
     if(err)
     {
         return err;
     }
 
-    // Transmit the next paring request.
-    err = unifying_loop(state, true, true, false);
+    if(state->interface->payload_available()) {
+        return unifying_receive(state);
+    }
+
+    return UNIFYING_SUCCESS;
+}
 
-    if(err)
+enum unifying_error unifying_tick(struct unifying_state* state)
+{
+    uint32_t current_time = state->interface->time();
+    enum unifying_error err = unifying_serve(state, current_time);
+
+    if(state->pairing.step)
     {
-        // If transmission failed then a pairing request is still buffered.
-        unifying_state_buffers_clear(state);
-        return err;
+        // Pairing is advanced after transmitting so that it sees responses received in the same tick.
+        return unifying_pair_advance(state, current_time, err);
     }
 
-    // Send a keep alive payload so we can receive a response.
-    err = unifying_loop(state, true, false, true);
+    return err;
+}
 
-    if(err)
+enum unifying_error unifying_loop(struct unifying_state* state,
+                                  bool exit_on_error,
+                                  bool exit_on_transmit,
+                                  bool exit_on_receive)
+{
+    enum unifying_error err = UNIFYING_SUCCESS;
+
+    while(true)
     {
-        // If transmission failed then a keep alive payload is still buffered.
-        unifying_state_buffers_clear(state);
-        return err;
+        if(exit_on_error && err)
+        {
+            // Some error occurred.
+            break;
+        }
+
+        if(exit_on_transmit && !unifying_transmit_pending(state))
+        {
+            // Transmit buffers empty.
+            break;
+        }
+
+        if(exit_on_receive && !unifying_ring_buffer_empty(state->receive_buffer))
+        {
+            // Payload received.
+            break;
+        }
+
+        unifying_wait(state);
+        err = unifying_tick(state);
     }
 
-    err = unifying_response(state, &receive_entry, UNIFYING_PAIR_RESPONSE_3_LEN);
+    return err;
+}
 
-    if(err)
+enum unifying_error unifying_pair_start(struct unifying_state* state,
+                                        uint8_t id,
+                                        uint16_t product_id,
+                                        uint16_t device_type,
+                                        uint32_t crypto,
+                                        uint32_t serial,
+                                        uint16_t capabilities,
+                                        const char* name,
+                                        uint8_t name_length)
+{
+    struct unifying_pairing* pairing = &state->pairing;
+
+    if(pairing->step)
     {
-        return err;
+        return UNIFYING_BUSY_ERROR;
     }
 
-    // Unpack the response.
-    struct unifying_pair_response_3 pair_response_3;
-    unifying_pair_response_3_unpack(&pair_response_3, receive_entry->payload);
-    unifying_receive_entry_destroy(receive_entry);
+    // Unifying appears to only support 16 character names.
+    if(name_length > UNIFYING_MAX_NAME_LEN)
+    {
+        return UNIFYING_NAME_LENGTH_ERROR;
+    }
 
-    // Check that we got the correct response to our pairing request.
-    if(pair_response_3.step != 6)
+    // Pairing begins on a predetermined address.
+    if(state->interface->set_address(unifying_pairing_address))
     {
-        return UNIFYING_PAIR_STEP_ERROR;
+        return UNIFYING_SET_ADDRESS_ERROR;
     }
 
-    err = unifying_pair_complete(state);
+    // Start with the pairing channel that worked last time.
+    pairing->sweep_position = 0;
+    pairing->dwell_start = state->interface->time();
 
-    if(err)
+    if(unifying_pair_channel_set(state))
     {
-        return err;
+        return UNIFYING_SET_CHANNEL_ERROR;
     }
 
-    // Transmit the next paring request.
-    err = unifying_loop(state, true, true, false);
+    unifying_state_name_set(state, name, name_length);
+
+    // We want total control of the buffers so we'll clear them before pairing.
+    unifying_state_buffers_clear(state);
+
+    // Drop any timeout raised by the idle ladder so the pairing request goes out now
+    // and the responses are polled at the default timeout.
+    state->last_activity = pairing->dwell_start;
+    state->idle_step = 0;
+    state->timeout = state->default_timeout;
+    state->next_transmit = pairing->dwell_start;
+
+    pairing->id = id;
+    pairing->product_id = product_id;
+    pairing->crypto = crypto;
+    pairing->serial = serial;
+    pairing->capabilities = capabilities;
+    memcpy(pairing->name, name, name_length);
+    pairing->name_length = name_length;
+    pairing->result = UNIFYING_BUSY_ERROR;
+    pairing->step = UNIFYING_PAIR_STEP_REQUEST_1;
+
+    // Queue a pairing packet for transmission.
+    return unifying_pair_step_1(state, id, product_id, device_type);
+}
+
+enum unifying_error unifying_pair_result(const struct unifying_state* state)
+{
+    return state->pairing.result;
+}
+
+enum unifying_error unifying_pair(struct unifying_state* state,
+                                  uint8_t id,
+                                  uint16_t product_id,
+                                  uint16_t device_type,
+                                  uint32_t crypto,
+                                  uint32_t serial,
+                                  uint16_t capabilities,
+                                  const char* name,
+                                  uint8_t name_length)
+{
+    enum unifying_error err = unifying_pair_start(state,
+                                                  id,
+                                                  product_id,
+                                                  device_type,
+                                                  crypto,
+                                                  serial,
+                                                  capabilities,
+                                                  name,
+                                                  name_length);
 
     if(err)
     {
-        // If transmission failed then a pairing request is still buffered.
-        unifying_state_buffers_clear(state);
         return err;
     }
 
-    // We've received all the information that we need to create an AES key.
-    // We need to deobfuscate it.
-    struct unifying_proto_aes_key proto_aes_key;
-    unifying_proto_aes_key_init(&proto_aes_key,
-                                pair_response_1.address,
-                                product_id,
-                                pair_response_1.product_id,
-                                crypto,
-                                pair_response_2.crypto);
-    uint8_t aes_buffer[UNIFYING_AES_BLOCK_LEN];
-    unifying_proto_aes_key_pack(aes_buffer, &proto_aes_key);
-    unifying_deobfuscate_aes_key(state->aes_key, aes_buffer);
+    while(state->pairing.step)
+    {
+        unifying_wait(state);
+        unifying_tick(state);
+    }
 
-    return UNIFYING_SUCCESS;
+    return unifying_pair_result(state);
 }
 
 enum unifying_error unifying_connect(struct unifying_state* state)
@@ -736,23 +1460,18 @@ enum unifying_error unifying_connect(struct unifying_state* state)
     struct unifying_transmit_entry* transmit_entry;
     struct unifying_short_wake_up_request request;
 
-    transmit_entry = unifying_transmit_entry_create(UNIFYING_SHORT_WAKE_UP_REQUEST_LEN, state->default_timeout);
+    transmit_entry = unifying_ring_buffer_reserve_back(&state->control_buffer);
 
     if(!transmit_entry)
     {
-        return UNIFYING_CREATE_ERROR;
+        return UNIFYING_BUFFER_FULL_ERROR;
     }
 
+    // Keep the timeout restored by unifying_state_link_restore() instead of going back to the default.
+    unifying_transmit_entry_init(transmit_entry, UNIFYING_SHORT_WAKE_UP_REQUEST_LEN, state->timeout);
     unifying_short_wake_up_request_init(&request, state->address[4]);
     unifying_short_wake_up_request_pack(transmit_entry->payload, &request);
-
-    err = unifying_ring_buffer_push_back(state->transmit_buffer, transmit_entry);
-
-    if(err)
-    {
-        unifying_transmit_entry_destroy(transmit_entry);
-        return err;
-    }
+    unifying_ring_buffer_commit_back(&state->control_buffer);
 
     // We don't know which channel the receiver is listening on.
     // Try to connect on each channel until one works.
@@ -775,72 +1494,250 @@ enum unifying_error unifying_connect(struct unifying_state* state)
 
 enum unifying_error unifying_set_timeout(struct unifying_state* state, uint16_t timeout)
 {
-    enum unifying_error err;
     struct unifying_transmit_entry* transmit_entry;
     struct unifying_set_timeout_request timeout_request;
 
-    transmit_entry = unifying_transmit_entry_create(UNIFYING_SET_TIMEOUT_REQUEST_LEN, timeout);
+    transmit_entry = unifying_ring_buffer_reserve_back(&state->control_buffer);
 
     if(!transmit_entry)
     {
-        return UNIFYING_CREATE_ERROR;
+        return UNIFYING_BUFFER_FULL_ERROR;
     }
 
+    unifying_transmit_entry_init(transmit_entry, UNIFYING_SET_TIMEOUT_REQUEST_LEN, timeout);
     unifying_set_timeout_request_init(&timeout_request, timeout);
     unifying_set_timeout_request_pack(transmit_entry->payload, &timeout_request);
+    unifying_ring_buffer_commit_back(&state->control_buffer);
 
-    err = unifying_ring_buffer_push_back(state->transmit_buffer, transmit_entry);
+    return UNIFYING_SUCCESS;
+}
+
+/*!
+ * Transmit an already encrypted keystroke and handle its response.
+ * 
+ * \param[in,out]   state       Unifying state information.
+ * \param[in]       aes_buffer  Keystroke data encrypted with \ref unifying_state.aes_counter "state.aes_counter".
+ * \param[in]       keys        Keyboard scancodes that \p aes_buffer was encrypted from.
+ * \param[in]       modifiers   Modifier bitfield that \p aes_buffer was encrypted from.
+ * 
+ * \return  See unifying_encrypted_keystroke().
+ */
+static enum unifying_error unifying_encrypted_keystroke_transmit(struct unifying_state* state,
+                                                                 uint8_t aes_buffer[UNIFYING_AES_DATA_LEN],
+                                                                 const uint8_t keys[UNIFYING_KEYS_LEN],
+                                                                 uint8_t modifiers)
+{
+    enum unifying_error err;
+    uint8_t payload[UNIFYING_ENCRYPTED_KEYSTROKE_REQUEST_LEN];
+    struct unifying_encrypted_keystroke_request request;
+
+    if(state->aes_counter_leased && (int32_t)(state->aes_counter - state->aes_counter_lease) >= 0)
+    {
+        // This counter value may have been used before the device last restarted.
+        return UNIFYING_COUNTER_LEASE_ERROR;
+    }
+
+    unifying_encrypted_keystroke_request_init(&request, aes_buffer, state->aes_counter);
+    unifying_encrypted_keystroke_request_pack(payload, &request);
+
+    err = unifying_transmit(state, payload, UNIFYING_ENCRYPTED_KEYSTROKE_REQUEST_LEN, state->default_timeout);
 
     if(err)
     {
-        unifying_transmit_entry_destroy(transmit_entry);
+        return err;
     }
 
-    return err;
+    state->aes_counter++;
+    unifying_input_transmitted(state);
+
+    // The receiver acknowledged the keystroke so this is what it believes is pressed now.
+    memcpy(state->keyboard_keys, keys, UNIFYING_KEYS_LEN);
+    state->keyboard_modifiers = modifiers;
+
+    if(state->interface->payload_available()) {
+        return unifying_receive(state);
+    }
+
+    return UNIFYING_SUCCESS;
 }
 
 enum unifying_error unifying_encrypted_keystroke(struct unifying_state* state,
                                                  const uint8_t keys[UNIFYING_KEYS_LEN],
                                                  uint8_t modifiers)
 {
-    enum unifying_error err;
     uint8_t aes_buffer[UNIFYING_AES_DATA_LEN];
-    uint8_t aes_iv[UNIFYING_AES_BLOCK_LEN];
-    uint8_t payload[UNIFYING_ENCRYPTED_KEYSTROKE_REQUEST_LEN];
-
     struct unifying_encrypted_keystroke_plaintext plaintext;
-    struct unifying_encrypted_keystroke_iv iv;
-    struct unifying_encrypted_keystroke_request request;
 
     unifying_encrypted_keystroke_plaintext_init(&plaintext, modifiers, keys);
     unifying_encrypted_keystroke_plaintext_pack(aes_buffer, &plaintext);
 
-    unifying_encrypted_keystroke_iv_init(&iv, state->aes_counter);
-    unifying_encrypted_keystroke_iv_pack(aes_iv, &iv);
-
-    if(state->interface->encrypt(aes_buffer, state->aes_key, aes_iv)) {
+    // This uses keystream precomputed by unifying_tick() if any is available.
+    if(unifying_state_keystroke_encrypt(state, aes_buffer)) {
         return UNIFYING_ENCRYPTION_ERROR;
     }
 
-    unifying_encrypted_keystroke_request_init(&request, aes_buffer, state->aes_counter);
-    unifying_encrypted_keystroke_request_pack(payload, &request);
+    return unifying_encrypted_keystroke_transmit(state, aes_buffer, keys, modifiers);
+}
 
-    err = unifying_transmit(state, payload, UNIFYING_ENCRYPTED_KEYSTROKE_REQUEST_LEN, state->default_timeout);
+/*!
+ * Check if a keyboard scancode is in a buffer of scancodes.
+ * 
+ * \param[in]   keys        Buffer of keyboard scancodes.
+ * \param[in]   length      Number of scancodes in \p keys.
+ * \param[in]   key         Keyboard scancode to look for.
+ * 
+ * \return  `true` if \p key is in \p keys.
+ * \return  `false` otherwise.
+ */
+static bool unifying_keys_contain(const uint8_t* keys, uint8_t length, uint8_t key)
+{
+    for(uint8_t i = 0; i < length; i++)
+    {
+        if(keys[i] == key)
+        {
+            return true;
+        }
+    }
 
-    if(err)
+    return false;
+}
+
+enum unifying_error unifying_keyboard(struct unifying_state* state,
+                                     const uint8_t keys[UNIFYING_KEYS_LEN],
+                                     uint8_t modifiers)
+{
+    enum unifying_error err;
+    uint8_t report[UNIFYING_KEYS_LEN];
+    uint8_t pressed[UNIFYING_KEYS_LEN];
+    uint8_t pressed_len = 0;
+
+    // Released keys are dropped all at once. Held keys stay in the same position.
+    // unifying_encrypted_keystroke() may have left duplicates behind, which are dropped too.
+    for(uint8_t i = 0; i < UNIFYING_KEYS_LEN; i++)
     {
-        return err;
+        uint8_t key = state->keyboard_keys[i];
+        report[i] = key &&
+                    unifying_keys_contain(keys, UNIFYING_KEYS_LEN, key) &&
+                    !unifying_keys_contain(report, i, key) ? key : 0;
     }
 
-    state->aes_counter++;
+    for(uint8_t i = 0; i < UNIFYING_KEYS_LEN; i++)
+    {
+        uint8_t key = keys[i];
 
-    if(state->interface->payload_available()) {
-        return unifying_receive(state);
+        if(key &&
+           !unifying_keys_contain(report, UNIFYING_KEYS_LEN, key) &&
+           !unifying_keys_contain(pressed, pressed_len, key))
+        {
+            pressed[pressed_len++] = key;
+        }
+    }
+
+    if(!pressed_len &&
+       modifiers == state->keyboard_modifiers &&
+       !memcmp(report, state->keyboard_keys, UNIFYING_KEYS_LEN))
+    {
+        // The receiver already has this report.
+        return UNIFYING_SUCCESS;
     }
 
+    // The receiver rejects reports that press more than one new key,
+    // so each newly pressed key gets its own report. Releases and modifiers ride along with the first one.
+    uint8_t next = 0;
+
+    do
+    {
+        if(next < pressed_len)
+        {
+            // The report and the pressed keys are distinct keys from keys,
+            // so there are at most UNIFYING_KEYS_LEN of them and a free position always exists.
+            uint8_t position = UNIFYING_KEYS_LEN - 1;
+
+            while(position < UNIFYING_KEYS_LEN && report[position])
+            {
+                position--;
+            }
+
+            if(position < UNIFYING_KEYS_LEN)
+            {
+                report[position] = pressed[next];
+            }
+
+            next++;
+        }
+
+        err = unifying_encrypted_keystroke(state, report, modifiers);
+
+        if(err)
+        {
+            // Reports that were acknowledged are remembered, so calling again picks up where this left off.
+            return err;
+        }
+    }
+    while(next < pressed_len);
+
     return UNIFYING_SUCCESS;
 }
 
+enum unifying_error unifying_encrypted_keystroke_batch(struct unifying_state* const states[],
+                                                       const uint8_t keys[][UNIFYING_KEYS_LEN],
+                                                       const uint8_t modifiers[],
+                                                       enum unifying_error results[],
+                                                       size_t count)
+{
+    enum unifying_error first_err = UNIFYING_SUCCESS;
+    struct unifying_encrypted_keystroke_plaintext plaintext;
+
+    for(size_t start = 0; start < count; start += UNIFYING_ENCRYPT_BATCH_LEN)
+    {
+        uint8_t aes_buffer[UNIFYING_ENCRYPT_BATCH_LEN][UNIFYING_AES_DATA_LEN];
+        size_t length = count - start;
+
+        if(length > UNIFYING_ENCRYPT_BATCH_LEN)
+        {
+            length = UNIFYING_ENCRYPT_BATCH_LEN;
+        }
+
+        for(size_t i = 0; i < length; i++)
+        {
+            unifying_encrypted_keystroke_plaintext_init(&plaintext, modifiers[start + i], keys[start + i]);
+            unifying_encrypted_keystroke_plaintext_pack(aes_buffer[i], &plaintext);
+        }
+
+        bool encrypt_failed = unifying_state_keystroke_encrypt_batch(&states[start], aes_buffer, length) != 0;
+
+        for(size_t i = 0; i < length; i++)
+        {
+            enum unifying_error err;
+
+            if(encrypt_failed)
+            {
+                // The batch doesn't report which block failed so none of them can be trusted.
+                err = UNIFYING_ENCRYPTION_ERROR;
+            }
+            else
+            {
+                err = unifying_encrypted_keystroke_transmit(states[start + i],
+                                                            aes_buffer[i],
+                                                            keys[start + i],
+                                                            modifiers[start + i]);
+            }
+
+            if(results)
+            {
+                results[start + i] = err;
+            }
+
+            if(err && !first_err)
+            {
+                first_err = err;
+            }
+        }
+    }
+
+    return first_err;
+}
+
 enum unifying_error unifying_multimeia_keystroke(struct unifying_state* state,
                                                  uint8_t keys[UNIFYING_MULTIMEDIA_KEYS_LEN])
 {
@@ -858,6 +1755,8 @@ enum unifying_error unifying_multimeia_keystroke(struct unifying_state* state,
         return err;
     }
 
+    unifying_input_transmitted(state);
+
     if(state->interface->payload_available()) {
         return unifying_receive(state);
     }
@@ -896,6 +1795,65 @@ enum unifying_error unifying_multimeia_keystroke(struct unifying_state* state,
 //     return UNIFYING_SUCCESS;
 // }
 
+/*!
+ * Take as much of a carried movement as fits in a single mouse payload.
+ * 
+ * \param[in,out]   carry   Carried movement. The returned movement is subtracted from it.
+ * \param[in]       min     Smallest movement that fits in a payload.
+ * \param[in]       max     Largest movement that fits in a payload.
+ * 
+ * \return  Movement to put in the payload.
+ */
+static int16_t unifying_mouse_carry_take(int32_t* carry, int16_t min, int16_t max)
+{
+    int16_t movement = *carry < min ? min : *carry > max ? max : *carry;
+
+    *carry -= movement;
+    return movement;
+}
+
+/*!
+ * Queue a mouse payload for the movement in \ref unifying_state.mouse_carry "state.mouse_carry".
+ * 
+ * Movement that doesn't fit in a single payload is left in the carry.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ * 
+ * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the transmit buffer is full.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+static enum unifying_error unifying_mouse_queue(struct unifying_state* state)
+{
+    struct unifying_mouse_carry* carry = &state->mouse_carry;
+    struct unifying_transmit_entry* transmit_entry;
+    struct unifying_mouse_request request;
+
+    transmit_entry = unifying_ring_buffer_reserve_back(state->transmit_buffer);
+
+    if(!transmit_entry)
+    {
+        return UNIFYING_BUFFER_FULL_ERROR;
+    }
+
+    unifying_transmit_entry_init(transmit_entry, UNIFYING_MOUSE_REQUEST_LEN, state->default_timeout);
+    unifying_mouse_request_init(&request,
+                                carry->buttons,
+                                unifying_mouse_carry_take(&carry->move_y,
+                                                          unifying_int12_clamp(INT16_MIN),
+                                                          unifying_int12_clamp(INT16_MAX)),
+                                unifying_mouse_carry_take(&carry->move_x,
+                                                          unifying_int12_clamp(INT16_MIN),
+                                                          unifying_int12_clamp(INT16_MAX)),
+                                unifying_mouse_carry_take(&carry->wheel_y, INT8_MIN, INT8_MAX),
+                                unifying_mouse_carry_take(&carry->wheel_x, INT8_MIN, INT8_MAX));
+    unifying_mouse_request_pack(transmit_entry->payload, &request);
+    unifying_ring_buffer_commit_back(state->transmit_buffer);
+
+    carry->pending = carry->move_y || carry->move_x || carry->wheel_y || carry->wheel_x;
+
+    return UNIFYING_SUCCESS;
+}
+
 enum unifying_error unifying_mouse(struct unifying_state* state,
                                    uint8_t buttons,
                                    int16_t move_y,
@@ -904,28 +1862,45 @@ enum unifying_error unifying_mouse(struct unifying_state* state,
                                    int8_t wheel_x)
 {
     enum unifying_error err;
-    struct unifying_transmit_entry* transmit_entry;
-    struct unifying_mouse_request request;
-
-    move_y = unifying_int12_clamp(move_y);
-    move_x = unifying_int12_clamp(move_x);
-
-    transmit_entry = unifying_transmit_entry_create(UNIFYING_MOUSE_REQUEST_LEN, state->default_timeout);
+    struct unifying_mouse_carry* carry = &state->mouse_carry;
 
-    if(!transmit_entry)
+    if(carry->pending && carry->buttons != buttons)
     {
-        return UNIFYING_CREATE_ERROR;
-    }
+        // Movement can't be merged across a button change,
+        // so everything carried for the previous buttons has to be queued first.
+        while(carry->pending)
+        {
+            err = unifying_mouse_queue(state);
 
-    unifying_mouse_request_init(&request, buttons, move_y, move_x, wheel_y, wheel_x);
-    unifying_mouse_request_pack(transmit_entry->payload, &request);
+            if(err)
+            {
+                // This report isn't accepted so the caller has to retry it.
+                return err;
+            }
+        }
+    }
 
-    err = unifying_ring_buffer_push_back(state->transmit_buffer, transmit_entry);
+    carry->buttons = buttons;
+    carry->pending = true;
+    carry->move_y += move_y;
+    carry->move_x += move_x;
+    carry->wheel_y += wheel_y;
+    carry->wheel_x += wheel_x;
 
-    if(err)
+    while(carry->pending)
     {
-        unifying_transmit_entry_destroy(transmit_entry);
+        if(unifying_mouse_queue(state))
+        {
+            // Whatever doesn't fit in the transmit buffer now is queued by the next call.
+            // See unifying_mouse_pending().
+            break;
+        }
     }
 
-    return err;
+    return UNIFYING_SUCCESS;
+}
+
+bool unifying_mouse_pending(const struct unifying_state* state)
+{
+    return state->mouse_carry.pending;
 }
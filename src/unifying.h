@@ -10,6 +10,7 @@
 #define UNIFYING_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "unifying_error.h"
@@ -27,14 +28,31 @@ extern "C" {
  * 
  * \todo    Define possible return values.
  * 
- * Transmit a queued payload shortly before the current timeout has elapsed.
- * If an unhandled response payload is bufferd then a
- * \ref unifying_hidpp_1_0_short "HID++" payload will be queued for transmission.
- * If no payload is queued for transmission then a
- * \ref unifying_keep_alive_request "keep-alive" payload will be queued for transmission..
+ * Transmit a payload shortly before the current timeout has elapsed.
+ * The payload is chosen by priority:
+ * 1. Input payloads queued in \ref unifying_state.transmit_buffer "state.transmit_buffer".
+ * 2. A \ref unifying_hidpp_1_0_short "HID++" payload in response to an unhandled received payload.
+ * 3. Control payloads queued in \ref unifying_state.control_buffer "state.control_buffer".
+ * 4. A \ref unifying_keep_alive_request "keep-alive" payload if nothing else needs transmitting.
+ * 
+ * The pairing process started by unifying_pair_start() is advanced after transmitting.
+ * 
+ * HID++ responses don't wait for the timeout. They are transmitted as soon as a query has been received,
+ * unless input payloads are due at the same time.
+ * 
+ * The keep-alive timeout is raised automatically while no input is transmitted,
+ * and queued payloads are then transmitted right away instead of waiting for the raised timeout.
+ * See unifying_state_idle_ladder_set().
+ * 
+ * This function only removes payloads from \ref unifying_state.transmit_buffer "state.transmit_buffer".
+ * Payloads may be queued from another context, such as an interrupt handler, while this function runs.
+ * See unifying_buffer.h.
  * 
  * If a payload was received in response to the transmission then it will be queued for later handling.
  * 
+ * While waiting to transmit, keystream for future \ref unifying_encrypted_keystroke "encrypted keystrokes"
+ * is precomputed one block at a time. See unifying_state_keystream_fill().
+ * 
  * \note This function is expected to be called regularly by the user of this library.
  * 
  * \param[in,out]   state   Unifying state information.
@@ -42,15 +60,39 @@ extern "C" {
  */
 enum unifying_error unifying_tick(struct unifying_state* state);
 
+/*!
+ * Get the time at which unifying_tick() will next transmit a payload.
+ * 
+ * unifying_tick() does nothing but precompute keystream before this time,
+ * so callers may sleep until then instead of calling it repeatedly.
+ * The deadline has already passed while a received payload is waiting to be handled,
+ * unless the response to it failed and is waiting to be retried.
+ * The deadline changes whenever a payload is transmitted.
+ * 
+ * \note    The deadline may have wrapped around past `UINT32_MAX`.
+ *          Use unifying_time_reached() to compare it against \ref unifying_interface.time "state.interface.time".
+ * 
+ * \param[in]   state   Unifying state information.
+ * 
+ * \return  Deadline in the same units as \ref unifying_interface.time "state.interface.time".
+ */
+uint32_t unifying_next_deadline(const struct unifying_state* state);
+
 /*!
  * Repeatedly call unifying_tick() until a condition is met.
  * 
+ * If \ref unifying_interface.wait_until "state.interface.wait_until" is set then
+ * this function sleeps until unifying_next_deadline() between transmissions
+ * instead of calling unifying_tick() as fast as possible.
+ * unifying_pair() and unifying_connect() wait the same way.
+ * 
  * \note    If all \p exit_on_* parameters are `false` then this function will never return.
  * 
  * \param[in,out]   state               Unifying state information.
  * \param[in]       exit_on_error       Return if unifying_tick() returns an error.
  * \param[in]       exit_on_transmit    Return if \ref unifying_state.transmit_buffer "state.transmit_buffer"
- *                                      is empty, implying that all payloads have been transmitted.
+ *                                      and \ref unifying_state.control_buffer "state.control_buffer"
+ *                                      are empty, implying that all payloads have been transmitted.
  * \param[in]       exit_on_receive     Return if \ref unifying_state.receive_buffer "state.receive_buffer"
  *                                      is not empty, implying that a payload has been received.
  * 
@@ -65,6 +107,8 @@ enum unifying_error unifying_loop(struct unifying_state* state,
 /*!
  * Pair with a Unifying receiver.
  * 
+ * This calls unifying_pair_start() and then calls unifying_tick() until pairing has finished.
+ * 
  * \todo    Define possible return values.
  * 
  * \note    Upon successfully pairing, this function will populate
@@ -87,6 +131,7 @@ enum unifying_error unifying_loop(struct unifying_state* state,
  * \param[in]       capabilities    HID++ capabilities.
  * \param[in]       name            Name of your device.
  *                                  This name will appear in the Logitech Unifying desktop software.
+ *                                  It is also reported through HID++ 2.0. See unifying_state_name_set().
  *                                  This value does not need to be NULL terminated.
  *                                  The name cannot be longer than \ref UNIFYING_MAX_NAME_LEN.
  * \param[in]       name_length     Length of the supplied name.
@@ -104,13 +149,63 @@ enum unifying_error unifying_pair(struct unifying_state* state,
                                   const char* name,
                                   uint8_t name_length);
 
+/*!
+ * Start pairing with a Unifying receiver without waiting for pairing to finish.
+ * 
+ * unifying_tick() advances the pairing process, so other work can be done while pairing,
+ * including pairing other states.
+ * 
+ * The initial request is swept across \ref unifying_pairing_channels, starting with the channel that
+ * worked last time and staying on each channel for \ref UNIFYING_PAIR_CHANNEL_DWELL.
+ * Each step transmits a request, then transmits keep-alive payloads
+ * until the receiver responds. Pairing fails with \ref UNIFYING_TIMEOUT_ERROR if a response takes longer than
+ * \ref UNIFYING_PAIR_RESPONSE_TIMEOUT. While pairing, received payloads are treated as pairing responses
+ * rather than HID++ queries.
+ * 
+ * See unifying_pair() for the meaning of each parameter.
+ * Use unifying_pair_result() to find out when pairing has finished.
+ * 
+ * \return  \ref UNIFYING_BUSY_ERROR if \p state is already pairing.
+ * \return  \ref UNIFYING_NAME_LENGTH_ERROR if \p name_length is longer than \ref UNIFYING_MAX_NAME_LEN.
+ * \return  \ref UNIFYING_SET_ADDRESS_ERROR if the pairing address could not be set.
+ * \return  \ref UNIFYING_SET_CHANNEL_ERROR if the first pairing channel could not be set.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+enum unifying_error unifying_pair_start(struct unifying_state* state,
+                                        uint8_t id,
+                                        uint16_t product_id,
+                                        uint16_t device_type,
+                                        uint32_t crypto,
+                                        uint32_t serial,
+                                        uint16_t capabilities,
+                                        const char* name,
+                                        uint8_t name_length);
+
+/*!
+ * Get the result of the pairing process started by unifying_pair_start().
+ * 
+ * \param[in]   state   Unifying state information.
+ * 
+ * \return  \ref UNIFYING_BUSY_ERROR while pairing.
+ * \return  \ref UNIFYING_PAIR_ERROR if pairing was never started.
+ * \return  The error that ended the pairing process.
+ * \return  \ref UNIFYING_SUCCESS if pairing succeeded.
+ */
+enum unifying_error unifying_pair_result(const struct unifying_state* state);
+
 /*!
  * Connect to a paired Unifying receiver.
  * 
- * \todo    Define possible return values.
+ * A wake-up request is transmitted on the current channel first. If that fails then every other channel is tried,
+ * in the order chosen by unifying_state_channel_next(). Restoring a snapshot with unifying_state_link_restore()
+ * beforehand usually lets the first transmission succeed.
  * 
  * \param[in,out]   state   Unifying state information.
  * 
+ * \return  \ref UNIFYING_BUFFER_FULL_ERROR if \ref unifying_state.control_buffer "state.control_buffer" is full.
+ * \return  \ref UNIFYING_TRANSMIT_ERROR if the receiver couldn't be reached on any channel.
+ * \return  Any other error returned by unifying_tick().
+ * \return  \ref UNIFYING_SUCCESS otherwise.
  */
 enum unifying_error unifying_connect(struct unifying_state* state);
 
@@ -118,12 +213,15 @@ enum unifying_error unifying_connect(struct unifying_state* state);
  * Queue a payload that sets the timeout for keep-alive packets.
  * 
  * This can be useful for conserving power when the user isn't actively using the device.
+ * unifying_tick() already does this automatically. See unifying_state_idle_ladder_set().
+ * 
+ * The payload is queued in \ref unifying_state.control_buffer "state.control_buffer"
+ * so this must be called from the same context as unifying_tick().
  * 
  * \param[in,out]   state       Unifying state information.
  * \param[in]       timeout     New packet timeout.
  * 
- * \return  \ref UNIFYING_CREATE_ERROR if dynamic memory allocation fails.
- * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the transmit buffer is full.
+ * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the control buffer is full.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  */
 enum unifying_error unifying_set_timeout(struct unifying_state* state, uint16_t timeout);
@@ -134,6 +232,7 @@ enum unifying_error unifying_set_timeout(struct unifying_state* state, uint16_t
  * \note    Sending 2 or more keyboard scancodes at once requires sending an intermediate payload
  *          for each additional keyboard scancode.
  *          Otherwise the Unifying receiver will reject the payload.
+ *          unifying_keyboard() takes care of this automatically.
  * \code{.c}
  * // e.g. Pressing 'a', 'b', and 'c' keys at the same time.
  * uint8_t keys[UNIFYING_KEYS_LEN] = {0, 0, 0, 0, 0, 0};
@@ -155,10 +254,10 @@ enum unifying_error unifying_set_timeout(struct unifying_state* state, uint16_t
  * \todo    Define modifiers key bits.
  * 
  * \return  \ref UNIFYING_ENCRYPTION_ERROR if payload encryption fails.
- * \return  \ref UNIFYING_CREATE_ERROR if dynamic memory allocation fails.
+ * \return  \ref UNIFYING_COUNTER_LEASE_ERROR if the AES counter has reached the end of its lease.
+ *          See unifying_state_counter_lease_renew().
  * \return  \ref UNIFYING_TRANSMIT_ERROR if payload transmission fails.
  * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the receive buffer is full and a response payload is available.
- * \return  \ref UNIFYING_CREATE_ERROR if dynamic memory allocation fails.
  * \return  \ref UNIFYING_PAYLOAD_LENGTH_ERROR if the response payload's length differs from its expected length.
  *          This should never happen.
  * \return  \ref UNIFYING_SUCCESS otherwise.
@@ -167,6 +266,61 @@ enum unifying_error unifying_encrypted_keystroke(struct unifying_state* state,
                                                  const uint8_t keys[UNIFYING_KEYS_LEN],
                                                  uint8_t modifiers);
 
+/*!
+ * Immediately transmit the encrypted keystrokes needed to report a set of pressed keys.
+ * 
+ * The set of pressed keys is compared against the last keystroke that the receiver acknowledged.
+ * Nothing is transmitted if nothing changed.
+ * Otherwise released keys and modifier changes are sent together with the first newly pressed key,
+ * and each further newly pressed key is sent in its own intermediate keystroke.
+ * This is the fewest keystrokes, and so AES operations, that the receiver will accept.
+ * Held keys keep their position and new keys take the last free position.
+ * \code{.c}
+ * // e.g. Pressing 'a', 'b', and 'c' keys at the same time transmits 3 keystrokes.
+ * uint8_t keys[UNIFYING_KEYS_LEN] = {0x04, 0x05, 0x06, 0, 0, 0};
+ * unifying_keyboard(&state, keys, 0);
+ * \endcode
+ * 
+ * \param[in,out]   state       Unifying state information.
+ * \param[in]       keys        Pointer to a buffer of \ref UNIFYING_KEYS_LEN keyboard scancodes in any order.
+ *                              Unused entries are `0`. Repeated scancodes are ignored.
+ * \param[in]       modifiers   Bitfield where each bit corresponds to a specific modifier key.
+ * 
+ * \return  Any error returned by unifying_encrypted_keystroke().
+ *          Keystrokes transmitted before the error are remembered,
+ *          so calling this again with the same keys transmits only what is left.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+enum unifying_error unifying_keyboard(struct unifying_state* state,
+                                     const uint8_t keys[UNIFYING_KEYS_LEN],
+                                     uint8_t modifiers);
+
+/*!
+ * Immediately transmit an encrypted keystroke payload for each of several states.
+ * 
+ * This behaves like calling unifying_encrypted_keystroke() once per state,
+ * but the AES encryption for up to \ref UNIFYING_ENCRYPT_BATCH_LEN states is done together.
+ * See unifying_state_keystroke_encrypt_batch().
+ * This is useful when a single program emulates many devices.
+ * 
+ * \param[in,out]   states      \p count pointers to Unifying state information.
+ *                              Each state should appear at most once.
+ * \param[in]       keys        \p count buffers of \ref UNIFYING_KEYS_LEN keyboard scancodes.
+ * \param[in]       modifiers   \p count modifier bitfields.
+ * \param[out]      results     Buffer of \p count errors, one for each state.
+ *                              This may be `NULL`.
+ * \param[in]       count       Number of states.
+ * 
+ * \return  The first error returned for any state.
+ *          See unifying_encrypted_keystroke() for possible values.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+enum unifying_error unifying_encrypted_keystroke_batch(struct unifying_state* const states[],
+                                                       const uint8_t keys[][UNIFYING_KEYS_LEN],
+                                                       const uint8_t modifiers[],
+                                                       enum unifying_error results[],
+                                                       size_t count);
+
 /*!
  * Immediately transmit a multimedia keystroke payload.
  * 
@@ -180,6 +334,15 @@ enum unifying_error unifying_multimeia_keystroke(struct unifying_state* state,
 /*!
  * Queue a mouse payload for transmission.
  * 
+ * The payload is queued in \ref unifying_state.transmit_buffer "state.transmit_buffer",
+ * so this may be called from a context other than the one calling unifying_tick().
+ * 
+ * Movement is never dropped. Movement that doesn't fit in a single payload, or that doesn't fit in
+ * the transmit buffer, is carried in \ref unifying_state.mouse_carry "state.mouse_carry" and queued
+ * by the next call. Use unifying_mouse_pending() to find out whether anything is still carried.
+ * unifying_tick() merges queued mouse payloads with the same buttons,
+ * so polling faster than payloads are transmitted doesn't build up latency.
+ * 
  * \param[in,out]   state       Unifying state information.
  * \param[in]       buttons     Bitfield where each bit corresponds to a mouse button.
  * \param[in]       move_y      Y axis mouse movement.
@@ -187,6 +350,9 @@ enum unifying_error unifying_multimeia_keystroke(struct unifying_state* state,
  * \param[in]       wheel_y     Y axis scroll wheel movement.
  * \param[in]       wheel_x     X axis scroll wheel movement.
  * 
+ * \return  \ref UNIFYING_BUFFER_FULL_ERROR if \p buttons changed and movement carried for the previous
+ *          buttons couldn't be queued. The report is not accepted and should be retried later.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
  */
 enum unifying_error unifying_mouse(struct unifying_state* state,
                                    uint8_t buttons,
@@ -195,6 +361,20 @@ enum unifying_error unifying_mouse(struct unifying_state* state,
                                    int8_t wheel_y,
                                    int8_t wheel_x);
 
+/*!
+ * Check if mouse movement accepted by unifying_mouse() is still waiting for space in the transmit buffer.
+ * 
+ * Carried movement is only queued by unifying_mouse(), so that the transmit buffer keeps a single producer.
+ * A device that stops calling unifying_mouse() when there is no new input should keep calling it
+ * with its current buttons and no movement while this returns `true`.
+ * 
+ * \param[in]   state   Unifying state information.
+ * 
+ * \return  `true` if movement is carried.
+ * \return  `false` otherwise.
+ */
+bool unifying_mouse_pending(const struct unifying_state* state);
+
 
 #ifdef __cplusplus
 }
@@ -1,24 +1,111 @@
 
 #include "unifying_buffer.h"
 
-enum unifying_error unifying_ring_buffer_init(struct unifying_ring_buffer* ring_buffer, void** buffer, uint8_t size)
+#if UNIFYING_C11_ATOMICS
+
+// The producer publishes an entry by releasing head after writing the entry,
+// and the consumer acquires head before reading it. Likewise for tail in the other direction.
+static inline unifying_ring_buffer_size unifying_ring_buffer_index_load(const unifying_ring_buffer_index* index)
+{
+    return atomic_load_explicit(index, memory_order_acquire);
+}
+
+static inline void unifying_ring_buffer_index_store(unifying_ring_buffer_index* index,
+                                                    unifying_ring_buffer_size value)
+{
+    atomic_store_explicit(index, value, memory_order_release);
+}
+
+#else
+
+#if defined(__GNUC__)
+// Stop the compiler from moving buffer accesses across index accesses.
+#define UNIFYING_RING_BUFFER_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define UNIFYING_RING_BUFFER_BARRIER()
+#endif
+
+static inline unifying_ring_buffer_size unifying_ring_buffer_index_load(const unifying_ring_buffer_index* index)
+{
+    unifying_ring_buffer_size value = *index;
+    UNIFYING_RING_BUFFER_BARRIER();
+    return value;
+}
+
+static inline void unifying_ring_buffer_index_store(unifying_ring_buffer_index* index,
+                                                    unifying_ring_buffer_size value)
+{
+    UNIFYING_RING_BUFFER_BARRIER();
+    *index = value;
+}
+
+#endif
+
+/*!
+ * Get the entry that an index refers to.
+ * 
+ * \param[in]   ring_buffer     Ring buffer the index belongs to.
+ * \param[in]   index           Index into the ring buffer.
+ * 
+ * \return  Pointer to the entry at \p index.
+ */
+static inline uint8_t* unifying_ring_buffer_entry(const struct unifying_ring_buffer* ring_buffer,
+                                                  unifying_ring_buffer_size index)
+{
+    return ring_buffer->buffer + (size_t)(index & (ring_buffer->size - 1)) * ring_buffer->entry_size;
+}
+
+/*!
+ * Count the entries between two ring buffer indices.
+ * 
+ * Indices wrap around freely so the difference is correct even if \p head has wrapped and \p tail has not.
+ * 
+ * \param[in]   head            Index one past the last entry.
+ * \param[in]   tail            Index of the first entry.
+ * 
+ * \return  Number of entries stored in the ring buffer.
+ */
+static inline unifying_ring_buffer_size unifying_ring_buffer_count(unifying_ring_buffer_size head,
+                                                                   unifying_ring_buffer_size tail)
 {
-    if(!size)
+    return (unifying_ring_buffer_size)(head - tail);
+}
+
+/*!
+ * Check that a ring buffer can be created with the given parameters.
+ * 
+ * \param[in]   entry_size      Size of a single entry in bytes.
+ * \param[in]   size            Number of entries.
+ * 
+ * \return  `true` if the parameters are valid.
+ * \return  `false` otherwise.
+ */
+static bool unifying_ring_buffer_valid(size_t entry_size, unifying_ring_buffer_size size)
+{
+    return entry_size && size && !(size & (size - 1)) && size <= UNIFYING_RING_BUFFER_MAX_SIZE;
+}
+
+enum unifying_error unifying_ring_buffer_init(struct unifying_ring_buffer* ring_buffer,
+                                              void* buffer,
+                                              size_t entry_size,
+                                              unifying_ring_buffer_size size)
+{
+    if(!unifying_ring_buffer_valid(entry_size, size))
     {
         return UNIFYING_BUFFER_ERROR;
     }
 
     ring_buffer->buffer = buffer;
+    ring_buffer->entry_size = entry_size;
     ring_buffer->size = size;
-    ring_buffer->count = 0;
-    ring_buffer->front = 0;
-    ring_buffer->back = size - 1;
+    unifying_ring_buffer_index_store(&ring_buffer->head, 0);
+    unifying_ring_buffer_index_store(&ring_buffer->tail, 0);
     return UNIFYING_SUCCESS;
 }
 
-struct unifying_ring_buffer* unifying_ring_buffer_create(uint8_t size)
+struct unifying_ring_buffer* unifying_ring_buffer_create(size_t entry_size, unifying_ring_buffer_size size)
 {
-    if(!size)
+    if(!unifying_ring_buffer_valid(entry_size, size))
     {
         return NULL;
     }
@@ -30,7 +117,7 @@ struct unifying_ring_buffer* unifying_ring_buffer_create(uint8_t size)
         return NULL;
     }
 
-    void** buffer = malloc(size * sizeof(void*));
+    void* buffer = malloc((size_t)size * entry_size);
 
     if(!buffer)
     {
@@ -38,7 +125,7 @@ struct unifying_ring_buffer* unifying_ring_buffer_create(uint8_t size)
         return NULL;
     }
 
-    unifying_ring_buffer_init(ring_buffer, buffer, size);
+    unifying_ring_buffer_init(ring_buffer, buffer, entry_size, size);
     return ring_buffer;
 }
 
@@ -48,98 +135,172 @@ void unifying_ring_buffer_destroy(struct unifying_ring_buffer* ring_buffer)
     free(ring_buffer);
 }
 
-enum unifying_error unifying_ring_buffer_push_front(struct unifying_ring_buffer* ring_buffer, void* entry)
+void* unifying_ring_buffer_reserve_back(struct unifying_ring_buffer* ring_buffer)
 {
-    if(unifying_ring_buffer_full(ring_buffer))
+    // Only the producer writes head so no ordering is needed to read it here.
+    unifying_ring_buffer_size head = ring_buffer->head;
+    unifying_ring_buffer_size tail = unifying_ring_buffer_index_load(&ring_buffer->tail);
+
+    if(unifying_ring_buffer_count(head, tail) >= ring_buffer->size)
     {
-        return UNIFYING_BUFFER_FULL_ERROR;
+        return NULL;
     }
 
-    if(ring_buffer->front)
+    return unifying_ring_buffer_entry(ring_buffer, head);
+}
+
+void unifying_ring_buffer_commit_back(struct unifying_ring_buffer* ring_buffer)
+{
+    // Publish the entry to the consumer.
+    unifying_ring_buffer_index_store(&ring_buffer->head, ring_buffer->head + 1);
+}
+
+enum unifying_error unifying_ring_buffer_push_front(struct unifying_ring_buffer* ring_buffer, const void* entry)
+{
+    if(unifying_ring_buffer_full(ring_buffer))
     {
-        ring_buffer->front -= 1;
+        return UNIFYING_BUFFER_FULL_ERROR;
     }
-    else
+
+    unifying_ring_buffer_size tail = ring_buffer->tail - 1;
+    memcpy(unifying_ring_buffer_entry(ring_buffer, tail), entry, ring_buffer->entry_size);
+    unifying_ring_buffer_index_store(&ring_buffer->tail, tail);
+    return UNIFYING_SUCCESS;
+}
+
+enum unifying_error unifying_ring_buffer_push_back(struct unifying_ring_buffer* ring_buffer, const void* entry)
+{
+    void* slot = unifying_ring_buffer_reserve_back(ring_buffer);
+
+    if(!slot)
     {
-        ring_buffer->front = ring_buffer->size - 1;
+        return UNIFYING_BUFFER_FULL_ERROR;
     }
 
-    ring_buffer->buffer[ring_buffer->front] = entry;
-    ring_buffer->count += 1;
+    memcpy(slot, entry, ring_buffer->entry_size);
+    unifying_ring_buffer_commit_back(ring_buffer);
     return UNIFYING_SUCCESS;
 }
 
-enum unifying_error unifying_ring_buffer_push_back(struct unifying_ring_buffer* ring_buffer, void* entry)
+size_t unifying_ring_buffer_push_n(struct unifying_ring_buffer* ring_buffer, const void* entries, size_t count)
 {
-    if(unifying_ring_buffer_full(ring_buffer))
+    unifying_ring_buffer_size head = ring_buffer->head;
+    unifying_ring_buffer_size tail = unifying_ring_buffer_index_load(&ring_buffer->tail);
+    size_t available = ring_buffer->size - unifying_ring_buffer_count(head, tail);
+
+    if(count > available)
     {
-        return UNIFYING_BUFFER_FULL_ERROR;
+        count = available;
     }
 
-    if(ring_buffer->back >= ring_buffer->size - 1)
+    if(!count)
     {
-        ring_buffer->back = 0;
+        return 0;
     }
-    else {
-        ring_buffer->back += 1;
+
+    // Copy up to the end of the storage, then wrap around to the start of it.
+    size_t position = head & (ring_buffer->size - 1);
+    size_t first = ring_buffer->size - position;
+
+    if(first > count)
+    {
+        first = count;
     }
 
-    ring_buffer->buffer[ring_buffer->back] = entry;
-    ring_buffer->count += 1;
-    return UNIFYING_SUCCESS;
+    memcpy(unifying_ring_buffer_entry(ring_buffer, head), entries, first * ring_buffer->entry_size);
+    memcpy(ring_buffer->buffer,
+           (const uint8_t*)entries + first * ring_buffer->entry_size,
+           (count - first) * ring_buffer->entry_size);
+
+    // Publish every entry at once.
+    unifying_ring_buffer_index_store(&ring_buffer->head, head + count);
+    return count;
 }
 
-void* unifying_ring_buffer_pop_front(struct unifying_ring_buffer* ring_buffer)
+enum unifying_error unifying_ring_buffer_pop_front(struct unifying_ring_buffer* ring_buffer)
 {
-    if(unifying_ring_buffer_empty(ring_buffer))
+    // Only the consumer writes tail so no ordering is needed to read it here.
+    unifying_ring_buffer_size tail = ring_buffer->tail;
+    unifying_ring_buffer_size head = unifying_ring_buffer_index_load(&ring_buffer->head);
+
+    if(head == tail)
     {
-        return NULL;
+        return UNIFYING_BUFFER_EMPTY_ERROR;
     }
 
-    void* entry = ring_buffer->buffer[ring_buffer->front];
-    ring_buffer->count -= 1;
+    // Hand the entry back to the producer.
+    unifying_ring_buffer_index_store(&ring_buffer->tail, tail + 1);
+    return UNIFYING_SUCCESS;
+}
+
+size_t unifying_ring_buffer_pop_n(struct unifying_ring_buffer* ring_buffer, void* entries, size_t count)
+{
+    unifying_ring_buffer_size tail = ring_buffer->tail;
+    unifying_ring_buffer_size head = unifying_ring_buffer_index_load(&ring_buffer->head);
+    size_t available = unifying_ring_buffer_count(head, tail);
 
-    if(ring_buffer->front >= ring_buffer->size - 1)
+    if(count > available)
     {
-        ring_buffer->front = 0;
+        count = available;
     }
-    else {
-        ring_buffer->front += 1;
+
+    if(entries)
+    {
+        // Copy up to the end of the storage, then wrap around to the start of it.
+        size_t position = tail & (ring_buffer->size - 1);
+        size_t first = ring_buffer->size - position;
+
+        if(first > count)
+        {
+            first = count;
+        }
+
+        memcpy(entries, unifying_ring_buffer_entry(ring_buffer, tail), first * ring_buffer->entry_size);
+        memcpy((uint8_t*)entries + first * ring_buffer->entry_size,
+               ring_buffer->buffer,
+               (count - first) * ring_buffer->entry_size);
     }
 
-    return entry;
+    // Hand every entry back to the producer at once.
+    unifying_ring_buffer_index_store(&ring_buffer->tail, tail + count);
+    return count;
 }
 
-void* unifying_ring_buffer_pop_back(struct unifying_ring_buffer* ring_buffer)
+enum unifying_error unifying_ring_buffer_pop_back(struct unifying_ring_buffer* ring_buffer)
 {
     if(unifying_ring_buffer_empty(ring_buffer))
     {
-        return NULL;
+        return UNIFYING_BUFFER_EMPTY_ERROR;
     }
 
-    void* entry = ring_buffer->buffer[ring_buffer->back];
-    ring_buffer->count -= 1;
+    unifying_ring_buffer_index_store(&ring_buffer->head, ring_buffer->head - 1);
+    return UNIFYING_SUCCESS;
+}
 
-    if(ring_buffer->back)
-    {
-        ring_buffer->back -= 1;
-    }
-    else
+void* unifying_ring_buffer_peek_front(struct unifying_ring_buffer* ring_buffer)
+{
+    unifying_ring_buffer_size tail = ring_buffer->tail;
+    unifying_ring_buffer_size head = unifying_ring_buffer_index_load(&ring_buffer->head);
+
+    if(head == tail)
     {
-        ring_buffer->back = ring_buffer->size - 1;
+        return NULL;
     }
 
-    return entry;
+    return unifying_ring_buffer_entry(ring_buffer, tail);
 }
 
-void* unifying_ring_buffer_peek_front(struct unifying_ring_buffer* ring_buffer)
+void* unifying_ring_buffer_peek_at(struct unifying_ring_buffer* ring_buffer, unifying_ring_buffer_size index)
 {
-    if(unifying_ring_buffer_empty(ring_buffer))
+    unifying_ring_buffer_size tail = ring_buffer->tail;
+    unifying_ring_buffer_size head = unifying_ring_buffer_index_load(&ring_buffer->head);
+
+    if(unifying_ring_buffer_count(head, tail) <= index)
     {
         return NULL;
     }
 
-    return ring_buffer->buffer[ring_buffer->front];
+    return unifying_ring_buffer_entry(ring_buffer, tail + index);
 }
 
 void* unifying_ring_buffer_peek_back(struct unifying_ring_buffer* ring_buffer)
@@ -149,15 +310,18 @@ void* unifying_ring_buffer_peek_back(struct unifying_ring_buffer* ring_buffer)
         return NULL;
     }
 
-    return ring_buffer->buffer[ring_buffer->back];
+    return unifying_ring_buffer_entry(ring_buffer, ring_buffer->head - 1);
 }
 
 bool unifying_ring_buffer_empty(const struct unifying_ring_buffer* ring_buffer)
 {
-    return !ring_buffer->count;
+    return unifying_ring_buffer_index_load(&ring_buffer->head) == unifying_ring_buffer_index_load(&ring_buffer->tail);
 }
 
 bool unifying_ring_buffer_full(const struct unifying_ring_buffer* ring_buffer)
 {
-    return ring_buffer->count >= ring_buffer->size;
+    unifying_ring_buffer_size head = unifying_ring_buffer_index_load(&ring_buffer->head);
+    unifying_ring_buffer_size tail = unifying_ring_buffer_index_load(&ring_buffer->tail);
+
+    return unifying_ring_buffer_count(head, tail) >= ring_buffer->size;
 }
@@ -2,6 +2,19 @@
 /*!
  * \file unifying_buffer.h
  * \brief Simple ring buffer used to store Unifying payloads
+ * 
+ * Entries are fixed size records stored contiguously inside the ring buffer.
+ * Producers pack data directly into a slot returned by unifying_ring_buffer_reserve_back()
+ * and consumers read it in place through unifying_ring_buffer_peek_front().
+ * 
+ * Ring buffers are safe to share between one producer and one consumer running concurrently,
+ * such as an interrupt handler capturing input and the main loop calling unifying_tick().
+ * The producer may only call unifying_ring_buffer_reserve_back(), unifying_ring_buffer_commit_back(),
+ * unifying_ring_buffer_push_back(), and unifying_ring_buffer_push_n().
+ * The consumer may only call unifying_ring_buffer_peek_front(), unifying_ring_buffer_peek_at(),
+ * unifying_ring_buffer_pop_front(), and unifying_ring_buffer_pop_n().
+ * Either side may call unifying_ring_buffer_empty() and unifying_ring_buffer_full().
+ * Every other function requires exclusive access to the ring buffer.
  */
 
 #ifndef UNIFYING_BUFFER_H
@@ -11,27 +24,95 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "unifying_error.h"
 
+#ifndef UNIFYING_C11_ATOMICS
+/*!
+ * Use C11 atomics for ring buffer indices.
+ * 
+ * This is enabled by default when compiling as C11 or later with atomics support.
+ * Otherwise indices are `volatile`, which is sufficient on single core microcontrollers
+ * as long as index loads and stores are atomic. See \ref UNIFYING_RING_BUFFER_INDEX_BITS.
+ * This can be re-defined by this library's user.
+ */
+#if !defined(__cplusplus) && defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && \
+    !defined(__STDC_NO_ATOMICS__) && !defined(__AVR__)
+#define UNIFYING_C11_ATOMICS 1
+#else
+#define UNIFYING_C11_ATOMICS 0
+#endif
+#endif
+
+#ifndef UNIFYING_RING_BUFFER_INDEX_BITS
+/*!
+ * Width of ring buffer indices in bits. Either `8` or `16`.
+ * 
+ * Indices must be loaded and stored atomically by both the producer and the consumer.
+ * 8 bit indices are used on AVR where 16 bit accesses take two instructions.
+ * This can be re-defined by this library's user.
+ */
+#if defined(__AVR__)
+#define UNIFYING_RING_BUFFER_INDEX_BITS 8
+#else
+#define UNIFYING_RING_BUFFER_INDEX_BITS 16
+#endif
+#endif
+
+#if UNIFYING_RING_BUFFER_INDEX_BITS == 8
+/// Unsigned integer type used for ring buffer sizes and indices.
+typedef uint8_t unifying_ring_buffer_size;
+#elif UNIFYING_RING_BUFFER_INDEX_BITS == 16
+/// Unsigned integer type used for ring buffer sizes and indices.
+typedef uint16_t unifying_ring_buffer_size;
+#else
+#error "UNIFYING_RING_BUFFER_INDEX_BITS must be 8 or 16"
+#endif
+
+#if UNIFYING_C11_ATOMICS
+#include <stdatomic.h>
+
+/// Ring buffer index shared between a producer and a consumer.
+typedef _Atomic unifying_ring_buffer_size unifying_ring_buffer_index;
+#else
+/// Ring buffer index shared between a producer and a consumer.
+typedef volatile unifying_ring_buffer_size unifying_ring_buffer_index;
+#endif
+
+/*!
+ * Largest number of entries a \ref unifying_ring_buffer "ring buffer" can hold.
+ * 
+ * Indices run freely and wrap around at the range of \ref unifying_ring_buffer_size,
+ * so a full buffer must hold fewer entries than that range to be told apart from an empty one.
+ * Sizes must also be a power of two so that an index can be turned into a position with a mask.
+ */
+#define UNIFYING_RING_BUFFER_MAX_SIZE (1U << (UNIFYING_RING_BUFFER_INDEX_BITS - 1))
+
 /*!
  * Ring buffer structure.
  * 
- * Stores arbitrary data pointers in a fixed length buffer
- * as well as the metadata necessary to access that data.
+ * Stores fixed size entries in a fixed length buffer
+ * as well as the metadata necessary to access those entries.
+ * 
+ * \ref unifying_ring_buffer.head "head" is only written by the producer and
+ * \ref unifying_ring_buffer.tail "tail" is only written by the consumer,
+ * so neither side ever has to wait for the other.
  */
 struct unifying_ring_buffer
 {
-    /// Pointer to a fixed size array of data pointers.
-    void** buffer;
-    /// Number of pointers that `buffer` can hold.
-    uint8_t size;
-    /// Number of items stored in `buffer`.
-    uint8_t count;
-    /// Index of the first item in the buffer.
-    uint8_t front;
-    /// Index of the last item in the buffer.
-    uint8_t back;
+    /// Pointer to storage for `size` entries of `entry_size` bytes each.
+    uint8_t* buffer;
+    /// Size of a single entry in bytes.
+    size_t entry_size;
+    /// Number of entries that `buffer` can hold. Always a power of two.
+    unifying_ring_buffer_size size;
+    /// Index one past the last entry in the buffer.
+    /// The entry's position in `buffer` is `head & (size - 1)`.
+    unifying_ring_buffer_index head;
+    /// Index of the first entry in the buffer.
+    /// The entry's position in `buffer` is `tail & (size - 1)`.
+    unifying_ring_buffer_index tail;
 };
 
 #ifdef __cplusplus
@@ -42,13 +123,20 @@ extern "C" {
  * Initialize a \ref unifying_ring_buffer "ring buffer" instance.
  * 
  * \param[out]  ring_buffer     Pointer to a ring buffer to initialize.
- * \param[in]   buffer          Pointer to pointer buffer.
- * \param[in]   size            Size of the pointer buffer.
+ * \param[in]   buffer          Storage for \p size entries of \p entry_size bytes each.
+ *                              Entries are accessed through pointers into this storage
+ *                              so it must be suitably aligned for the entry type.
+ * \param[in]   entry_size      Size of a single entry in bytes.
+ * \param[in]   size            Number of entries that \p buffer can hold. Must be a power of two.
  * 
- * \return  \ref UNIFYING_BUFFER_ERROR if \p size is `0`.
+ * \return  \ref UNIFYING_BUFFER_ERROR if \p entry_size is `0`, if \p size is not a power of two,
+ *          or if \p size is larger than \ref UNIFYING_RING_BUFFER_MAX_SIZE.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  */
-enum unifying_error unifying_ring_buffer_init(struct unifying_ring_buffer* ring_buffer, void** buffer, uint8_t size);
+enum unifying_error unifying_ring_buffer_init(struct unifying_ring_buffer* ring_buffer,
+                                              void* buffer,
+                                              size_t entry_size,
+                                              unifying_ring_buffer_size size);
 
 /*!
  * Allocate and initialize a \ref unifying_ring_buffer "ring buffer" instance.
@@ -56,14 +144,16 @@ enum unifying_error unifying_ring_buffer_init(struct unifying_ring_buffer* ring_
  * Ring buffers created with this function should be freed with
  * unifying_ring_buffer_destroy() when they are no longer needed.
  * 
- * \param[in]   size    Number of pointers the allocated buffer can store.
+ * \param[in]   entry_size  Size of a single entry in bytes.
+ * \param[in]   size        Number of entries the allocated buffer can store. Must be a power of two.
  * 
- * \return  `NULL` if \p size is `0` or if allocation fails.
+ * \return  `NULL` if \p entry_size is `0`, \p size is not a power of two,
+ *          \p size is larger than \ref UNIFYING_RING_BUFFER_MAX_SIZE, or if allocation fails.
  * \return  \ref unifying_ring_buffer pointer otherwise.
  * 
  * \see     unifying_ring_buffer_destroy()
  */
-struct unifying_ring_buffer* unifying_ring_buffer_create(uint8_t size);
+struct unifying_ring_buffer* unifying_ring_buffer_create(size_t entry_size, unifying_ring_buffer_size size);
 
 /*!
  * Free a dynamically allocated ring buffer instance.
@@ -75,64 +165,160 @@ struct unifying_ring_buffer* unifying_ring_buffer_create(uint8_t size);
 void unifying_ring_buffer_destroy(struct unifying_ring_buffer* ring_buffer);
 
 /*!
- * Add a pointer to the front of a ring buffer.
+ * Get the unused entry at the back of a ring buffer so that it can be filled in place.
+ * 
+ * The entry is not part of the ring buffer until unifying_ring_buffer_commit_back() is called.
+ * Calling this again before committing returns the same entry.
+ * 
+ * This is the producer side of the ring buffer.
+ * 
+ * \param[in,out]   ring_buffer     Ring buffer to get an entry from.
+ * 
+ * \return  `NULL` if the buffer is full.
+ * \return  Pointer to an entry of \ref unifying_ring_buffer.entry_size "entry_size" bytes otherwise.
+ * 
+ * \see     unifying_ring_buffer_commit_back()
+ */
+void* unifying_ring_buffer_reserve_back(struct unifying_ring_buffer* ring_buffer);
+
+/*!
+ * Add the entry returned by unifying_ring_buffer_reserve_back() to the back of a ring buffer.
+ * 
+ * This is the producer side of the ring buffer.
+ * 
+ * \note    This must only be called after unifying_ring_buffer_reserve_back() returned an entry.
+ * 
+ * \param[in,out]   ring_buffer     Ring buffer to add the entry to.
+ * 
+ * \see     unifying_ring_buffer_reserve_back()
+ */
+void unifying_ring_buffer_commit_back(struct unifying_ring_buffer* ring_buffer);
+
+/*!
+ * Copy an entry to the front of a ring buffer.
  * 
- * \param[in,out]   ring_buffer     Ring buffer to add a pointer to.
- * \param[in]       entry           Pointer to add to the ring buffer.
+ * \note    This must not be called while another context is using the ring buffer.
+ * 
+ * \param[in,out]   ring_buffer     Ring buffer to add an entry to.
+ * \param[in]       entry           Pointer to \ref unifying_ring_buffer.entry_size "entry_size" bytes to copy.
  * 
  * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the buffer is full.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  */
-enum unifying_error unifying_ring_buffer_push_front(struct unifying_ring_buffer* ring_buffer, void* entry);
+enum unifying_error unifying_ring_buffer_push_front(struct unifying_ring_buffer* ring_buffer, const void* entry);
 
 /*!
- * Add a pointer to the back of a ring buffer.
+ * Copy an entry to the back of a ring buffer.
+ * 
+ * This is the producer side of the ring buffer.
+ * Prefer unifying_ring_buffer_reserve_back() to avoid the copy.
  * 
- * \param[in,out]   ring_buffer     Ring buffer to add a pointer to.
- * \param[in]       entry           Pointer to add to the ring buffer.
+ * \param[in,out]   ring_buffer     Ring buffer to add an entry to.
+ * \param[in]       entry           Pointer to \ref unifying_ring_buffer.entry_size "entry_size" bytes to copy.
  * 
  * \return  \ref UNIFYING_BUFFER_FULL_ERROR if the buffer is full.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  */
-enum unifying_error unifying_ring_buffer_push_back(struct unifying_ring_buffer* ring_buffer, void* entry);
+enum unifying_error unifying_ring_buffer_push_back(struct unifying_ring_buffer* ring_buffer, const void* entry);
 
 /*!
- * Remove a pointer from the front of a ring buffer and return it.
+ * Copy several entries to the back of a ring buffer.
  * 
- * \param[in,out]   ring_buffer     Ring buffer to remove a pointer from.
+ * As many entries as fit are copied with at most two copies and published together.
  * 
- * \return  `NULL` if the buffer is empty.
- * \return  `void*` to some data otherwise.
+ * This is the producer side of the ring buffer.
+ * 
+ * \param[in,out]   ring_buffer     Ring buffer to add entries to.
+ * \param[in]       entries         Pointer to \p count entries of
+ *                                  \ref unifying_ring_buffer.entry_size "entry_size" bytes each.
+ * \param[in]       count           Number of entries to copy.
+ * 
+ * \return  Number of entries copied. This is less than \p count if the buffer became full.
  */
-void* unifying_ring_buffer_pop_front(struct unifying_ring_buffer* ring_buffer);
+size_t unifying_ring_buffer_push_n(struct unifying_ring_buffer* ring_buffer, const void* entries, size_t count);
 
 /*!
- * Remove a pointer from the back of a ring buffer and return it.
+ * Remove the entry at the front of a ring buffer.
  * 
- * \param[in,out]   ring_buffer     Ring buffer to remove a pointer from.
+ * Pointers previously returned by unifying_ring_buffer_peek_front() for this entry become invalid.
  * 
- * \return  `NULL` if the buffer is empty.
- * \return  `void*` to some data otherwise.
+ * This is the consumer side of the ring buffer.
+ * 
+ * \param[in,out]   ring_buffer     Ring buffer to remove an entry from.
+ * 
+ * \return  \ref UNIFYING_BUFFER_EMPTY_ERROR if the buffer is empty.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+enum unifying_error unifying_ring_buffer_pop_front(struct unifying_ring_buffer* ring_buffer);
+
+/*!
+ * Copy several entries from the front of a ring buffer and remove them.
+ * 
+ * As many entries as are available are copied with at most two copies and released together.
+ * 
+ * This is the consumer side of the ring buffer.
+ * 
+ * \param[in,out]   ring_buffer     Ring buffer to remove entries from.
+ * \param[out]      entries         Storage for \p count entries of
+ *                                  \ref unifying_ring_buffer.entry_size "entry_size" bytes each.
+ *                                  If this is `NULL` then entries are removed without being copied.
+ * \param[in]       count           Largest number of entries to remove.
+ * 
+ * \return  Number of entries removed. This is less than \p count if the buffer became empty.
  */
-void* unifying_ring_buffer_pop_back(struct unifying_ring_buffer* ring_buffer);
+size_t unifying_ring_buffer_pop_n(struct unifying_ring_buffer* ring_buffer, void* entries, size_t count);
 
 /*!
- * Return the pointer at the front of the buffer but do not remove it from the buffer.
+ * Remove the entry at the back of a ring buffer.
+ * 
+ * \note    This must not be called while another context is using the ring buffer.
+ * 
+ * \param[in,out]   ring_buffer     Ring buffer to remove an entry from.
+ * 
+ * \return  \ref UNIFYING_BUFFER_EMPTY_ERROR if the buffer is empty.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+enum unifying_error unifying_ring_buffer_pop_back(struct unifying_ring_buffer* ring_buffer);
+
+/*!
+ * Return the entry at the front of the buffer but do not remove it from the buffer.
+ * 
+ * The entry stays valid until it is removed with unifying_ring_buffer_pop_front().
  * 
- * \param[in]   ring_buffer     Ring buffer to get a pointer from.
+ * This may be called by the consumer.
+ * 
+ * \param[in]   ring_buffer     Ring buffer to get an entry from.
  * 
  * \return  `NULL` if the buffer is empty.
- * \return  `void*` to some data otherwise.
+ * \return  Pointer to the entry otherwise.
  */
 void* unifying_ring_buffer_peek_front(struct unifying_ring_buffer* ring_buffer);
 
 /*!
- * Return the pointer at the back of the buffer but do not remove it from the buffer.
+ * Return an entry counting from the front of the buffer but do not remove it from the buffer.
+ * 
+ * The entry stays valid until it is removed with unifying_ring_buffer_pop_front().
+ * The consumer owns every entry it can peek at, so it may also modify them in place.
+ * 
+ * This may be called by the consumer.
+ * 
+ * \param[in]   ring_buffer     Ring buffer to get an entry from.
+ * \param[in]   index           Position of the entry. `0` is the front of the buffer.
+ * 
+ * \return  `NULL` if the buffer holds \p index entries or fewer.
+ * \return  Pointer to the entry otherwise.
+ */
+void* unifying_ring_buffer_peek_at(struct unifying_ring_buffer* ring_buffer, unifying_ring_buffer_size index);
+
+/*!
+ * Return the entry at the back of the buffer but do not remove it from the buffer.
+ * 
+ * \note    This must not be called while another context is using the ring buffer.
  * 
- * \param[in]   ring_buffer     Ring buffer to get a pointer from.
+ * \param[in]   ring_buffer     Ring buffer to get an entry from.
  * 
  * \return  `NULL` if the buffer is empty.
- * \return  `void*` to some data otherwise.
+ * \return  Pointer to the entry otherwise.
  */
 void* unifying_ring_buffer_peek_back(struct unifying_ring_buffer* ring_buffer);
 
@@ -15,14 +15,32 @@
 
 #include <stdint.h>
 
-#ifndef UNIFYING_TIMEOUT_COEFFICIENT
+#ifdef UNIFYING_TIMEOUT_COEFFICIENT
+#error "UNIFYING_TIMEOUT_COEFFICIENT has been replaced by UNIFYING_TIMEOUT_FRACTION"
+#endif
+
+#ifndef UNIFYING_TIMEOUT_FRACTION
 /*!
- * Determines what percent of the timeout should elapse before transmitting a keep-alive packet.
+ * Determines what fraction of the timeout should elapse before transmitting a keep-alive packet.
  * 
+ * The fraction is expressed in 256ths so that no floating point math is needed.
+ * The default of `224` is 87.5%.
  * This can be re-defined by this library's user.
- * Defining this as a number greater than `1` will most like cause packets to timeout.
+ * Defining this as a number greater than `256` will most likely cause packets to timeout.
  */
-#define UNIFYING_TIMEOUT_COEFFICIENT 0.875
+#define UNIFYING_TIMEOUT_FRACTION 224
+#endif
+
+#ifndef UNIFYING_TIME_TICKS_PER_MS
+/*!
+ * Number of \ref unifying_interface.time "time" units per millisecond.
+ * 
+ * The default of `1` expects a millisecond time source such as Arduino's `millis()`.
+ * Defining this as `1000` allows a microsecond time source such as Arduino's `micros()`,
+ * which schedules keep-alive packets with sub-millisecond precision.
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_TIME_TICKS_PER_MS 1
 #endif
 
 /*!
@@ -170,6 +188,16 @@
  */
 #define UNIFYING_HIDPP_1_0_LONG_PARAMS_LEN 17
 
+/*!
+ * Size of a short HID++ 1.0 register's value in bytes.
+ */
+#define UNIFYING_HIDPP_1_0_SHORT_REGISTER_LEN 3
+
+/*!
+ * Size of a long HID++ 1.0 register's value in bytes.
+ */
+#define UNIFYING_HIDPP_1_0_LONG_REGISTER_LEN 16
+
 /*!
  * HID++ 1.0 `SET_REGISTER` SubID.
  */
@@ -260,6 +288,56 @@
  */
 #define UNIFYING_HIDPP_1_0_ERROR_WRONG_PIN_CODE 0x0C
 
+/*!
+ * Number of parameter bytes in a HID++ 2.0 response, following the function and software IDs.
+ */
+#define UNIFYING_HIDPP_2_0_RESPONSE_LEN 16
+
+/*!
+ * Feature index that HID++ 2.0 error responses are sent with.
+ */
+#define UNIFYING_HIDPP_2_0_ERROR_FEATURE_INDEX 0xFF
+
+/*!
+ * HID++ 2.0 `ROOT` feature ID. This is always at feature index 0.
+ */
+#define UNIFYING_HIDPP_2_0_FEATURE_ROOT 0x0000
+
+/*!
+ * HID++ 2.0 `FEATURE_SET` feature ID.
+ */
+#define UNIFYING_HIDPP_2_0_FEATURE_FEATURE_SET 0x0001
+
+/*!
+ * HID++ 2.0 `DEVICE_NAME_TYPE` feature ID.
+ */
+#define UNIFYING_HIDPP_2_0_FEATURE_DEVICE_NAME_TYPE 0x0005
+
+/*!
+ * HID++ 2.0 protocol major version reported by the `ROOT` feature.
+ */
+#define UNIFYING_HIDPP_2_0_PROTOCOL_MAJOR 4
+
+/*!
+ * HID++ 2.0 protocol minor version reported by the `ROOT` feature.
+ */
+#define UNIFYING_HIDPP_2_0_PROTOCOL_MINOR 2
+
+/*!
+ * HID++ 2.0 `INVALID_ARGUMENT` error code.
+ */
+#define UNIFYING_HIDPP_2_0_ERROR_INVALID_ARGUMENT 0x02
+
+/*!
+ * HID++ 2.0 `INVALID_FEATURE_INDEX` error code.
+ */
+#define UNIFYING_HIDPP_2_0_ERROR_INVALID_FEATURE_INDEX 0x06
+
+/*!
+ * HID++ 2.0 `INVALID_FUNCTION_ID` error code.
+ */
+#define UNIFYING_HIDPP_2_0_ERROR_INVALID_FUNCTION_ID 0x07
+
 // These are the only supported default timeouts according to the HID++ 1.0 specification.
 /*!
  * Default HID++ timeout for keyboards.
@@ -1,6 +1,57 @@
 
 #include "unifying_data.h"
 
+/*
+ * Each payload's layout is listed once, in payload order, as an X-macro of its fields.
+ * Expanding the list with UNIFYING_PACK_FIELD or UNIFYING_UNPACK_FIELD generates straight-line
+ * code with every offset known at compile time, so multi-byte integers become fused big-endian
+ * byte stores and loads instead of calls and no descriptor table has to be kept in memory.
+ */
+
+/*!
+ * Pack one field of a payload struct.
+ * 
+ * \param[in]   type    `UINT8`, `UINT16`, `UINT32` or `BYTES`.
+ * \param[in]   field   Name of the field.
+ * \param[in]   offset  Offset of the field in the packed payload.
+ */
+#define UNIFYING_PACK_FIELD(type, field, offset) UNIFYING_PACK_##type(&packed[offset], unpacked->field);
+
+/*!
+ * Unpack one field of a payload struct.
+ * 
+ * \param[in]   type    `UINT8`, `UINT16`, `UINT32` or `BYTES`.
+ * \param[in]   field   Name of the field.
+ * \param[in]   offset  Offset of the field in the packed payload.
+ */
+#define UNIFYING_UNPACK_FIELD(type, field, offset) UNIFYING_UNPACK_##type(unpacked->field, &packed[offset]);
+
+#define UNIFYING_PACK_UINT8(packed, unpacked) \
+    (packed)[0] = (unpacked)
+#define UNIFYING_PACK_UINT16(packed, unpacked) \
+    (packed)[0] = (uint8_t) ((unpacked) >> 8), \
+    (packed)[1] = (uint8_t) (unpacked)
+#define UNIFYING_PACK_UINT32(packed, unpacked) \
+    (packed)[0] = (uint8_t) ((unpacked) >> 24), \
+    (packed)[1] = (uint8_t) ((unpacked) >> 16), \
+    (packed)[2] = (uint8_t) ((unpacked) >> 8), \
+    (packed)[3] = (uint8_t) (unpacked)
+#define UNIFYING_PACK_BYTES(packed, unpacked) \
+    memcpy((packed), (unpacked), sizeof(unpacked))
+
+#define UNIFYING_UNPACK_UINT8(unpacked, packed) \
+    (unpacked) = (packed)[0]
+#define UNIFYING_UNPACK_UINT16(unpacked, packed) \
+    (unpacked) = (uint16_t) ((uint16_t) (packed)[0] << 8 | (packed)[1])
+#define UNIFYING_UNPACK_UINT32(unpacked, packed) \
+    (unpacked) = (uint32_t) (packed)[0] << 24 | \
+                 (uint32_t) (packed)[1] << 16 | \
+                 (uint32_t) (packed)[2] << 8 | \
+                 (uint32_t) (packed)[3]
+#define UNIFYING_UNPACK_BYTES(unpacked, packed) \
+    memcpy((unpacked), (packed), sizeof(unpacked))
+
+
 void unifying_pair_request_1_init(struct unifying_pair_request_1* unpacked,
                                   uint8_t id,
                                   uint16_t timeout,
@@ -19,36 +70,42 @@ void unifying_pair_request_1_init(struct unifying_pair_request_1* unpacked,
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_pair_request_1));
 }
 
+#define UNIFYING_PAIR_REQUEST_1_FIELDS(FIELD) \
+    FIELD(UINT8, id, 0)                       \
+    FIELD(UINT8, frame, 1)                    \
+    FIELD(UINT8, step, 2)                     \
+    FIELD(BYTES, unknown_3_7, 3)              \
+    FIELD(UINT8, timeout, 8)                  \
+    FIELD(UINT16, product_id, 9)              \
+    FIELD(UINT8, protocol, 11)                \
+    FIELD(UINT8, unknown_12, 12)              \
+    FIELD(UINT16, device_type, 13)            \
+    FIELD(BYTES, unknown_15_19, 15)           \
+    FIELD(UINT8, unknown_20, 20)              \
+    FIELD(UINT8, checksum, 21)
+
 void unifying_pair_request_1_pack(uint8_t packed[UNIFYING_PAIR_REQUEST_1_LEN],
                                   const struct unifying_pair_request_1* unpacked)
 {
-    packed[0] = unpacked->id;
-    packed[1] = unpacked->frame;
-    packed[2] = unpacked->step;
-    memcpy(&packed[3], unpacked->unknown_3_7, sizeof(unpacked->unknown_3_7));
-    packed[8] = unpacked->timeout;
-    unifying_uint16_pack(&packed[9], unpacked->product_id);
-    packed[11] = unpacked->protocol;
-    packed[12] = unpacked->unknown_12;
-    unifying_uint16_pack(&packed[13], unpacked->device_type);
-    memcpy(&packed[15], unpacked->unknown_15_19, sizeof(unpacked->unknown_15_19));
-    packed[20] = unpacked->unknown_20;
-    packed[21] = unpacked->checksum;
+    UNIFYING_PAIR_REQUEST_1_FIELDS(UNIFYING_PACK_FIELD)
 }
 
+#define UNIFYING_PAIR_RESPONSE_1_FIELDS(FIELD) \
+    FIELD(UINT8, id, 0)                        \
+    FIELD(UINT8, frame, 1)                     \
+    FIELD(UINT8, step, 2)                      \
+    FIELD(BYTES, address, 3)                   \
+    FIELD(UINT8, unknown_8, 8)                 \
+    FIELD(UINT16, product_id, 9)               \
+    FIELD(BYTES, unknown_11_12, 11)            \
+    FIELD(UINT16, device_type, 13)             \
+    FIELD(BYTES, unknown_15_20, 15)            \
+    FIELD(UINT8, checksum, 21)
+
 void unifying_pair_response_1_unpack(struct unifying_pair_response_1* unpacked,
                                      const uint8_t packed[UNIFYING_PAIR_RESPONSE_1_LEN])
 {
-    unpacked->id = packed[0];
-    unpacked->frame = packed[1];
-    unpacked->step = packed[2];
-    memcpy(unpacked->address, &packed[3], sizeof(unpacked->address));
-    unpacked->unknown_8 = packed[8];
-    unifying_uint16_unpack(&unpacked->product_id, &packed[9]);
-    memcpy(unpacked->unknown_11_12, &packed[11], sizeof(unpacked->unknown_11_12));
-    unifying_uint16_unpack(&unpacked->device_type, &packed[13]);
-    memcpy(unpacked->unknown_15_20, &packed[15], sizeof(unpacked->unknown_15_20));
-    unpacked->checksum = packed[21];
+    UNIFYING_PAIR_RESPONSE_1_FIELDS(UNIFYING_UNPACK_FIELD)
 }
 
 
@@ -64,34 +121,29 @@ void unifying_pair_request_2_init(struct unifying_pair_request_2* unpacked,
     unpacked->crypto = crypto;
     unpacked->serial = serial;
     unpacked->capabilities = capabilities;
-    unpacked->unknown_13_20[15] = 0x01;
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_pair_request_2));
 }
 
+#define UNIFYING_PAIR_2_FIELDS(FIELD) \
+    FIELD(UINT8, unknown_0, 0)        \
+    FIELD(UINT8, frame, 1)            \
+    FIELD(UINT8, step, 2)             \
+    FIELD(UINT32, crypto, 3)          \
+    FIELD(UINT32, serial, 7)          \
+    FIELD(UINT16, capabilities, 11)   \
+    FIELD(BYTES, unknown_13_20, 13)   \
+    FIELD(UINT8, checksum, 21)
+
 void unifying_pair_request_2_pack(uint8_t packed[UNIFYING_PAIR_REQUEST_2_LEN],
                                   const struct unifying_pair_request_2* unpacked)
 {
-    packed[0] = unpacked->unknown_0;
-    packed[1] = unpacked->frame;
-    packed[2] = unpacked->step;
-    unifying_uint32_pack(&packed[3], unpacked->crypto);
-    unifying_uint32_pack(&packed[7], unpacked->serial);
-    unifying_uint16_pack(&packed[11], unpacked->capabilities);
-    memcpy(&packed[13], unpacked->unknown_13_20, sizeof(unpacked->unknown_13_20));
-    packed[21] = unpacked->checksum;
+    UNIFYING_PAIR_2_FIELDS(UNIFYING_PACK_FIELD)
 }
 
 void unifying_pair_response_2_unpack(struct unifying_pair_response_2* unpacked,
                                      const uint8_t packed[UNIFYING_PAIR_RESPONSE_2_LEN])
 {
-    unpacked->unknown_0 = packed[0];
-    unpacked->frame = packed[1];
-    unpacked->step = packed[2];
-    unifying_uint32_unpack(&unpacked->crypto, &packed[3]);
-    unifying_uint32_unpack(&unpacked->serial, &packed[7]);
-    unifying_uint16_unpack(&unpacked->capabilities, &packed[11]);
-    memcpy(unpacked->unknown_13_20, &packed[13], sizeof(unpacked->unknown_13_20));
-    unpacked->checksum = packed[21];
+    UNIFYING_PAIR_2_FIELDS(UNIFYING_UNPACK_FIELD)
 }
 
 
@@ -107,26 +159,32 @@ void unifying_pair_request_3_init(struct unifying_pair_request_3* unpacked, cons
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_pair_request_3));
 }
 
+#define UNIFYING_PAIR_REQUEST_3_FIELDS(FIELD) \
+    FIELD(UINT8, unknown_0, 0)                \
+    FIELD(UINT8, frame, 1)                    \
+    FIELD(UINT8, step, 2)                     \
+    FIELD(UINT8, unknown_3, 3)                \
+    FIELD(UINT8, name_length, 4)              \
+    FIELD(BYTES, name, 5)                     \
+    FIELD(UINT8, checksum, 21)
+
 void unifying_pair_request_3_pack(uint8_t packed[UNIFYING_PAIR_REQUEST_3_LEN],
                                   const struct unifying_pair_request_3* unpacked)
 {
-    packed[0] = unpacked->unknown_0;
-    packed[1] = unpacked->frame;
-    packed[2] = unpacked->step;
-    packed[3] = unpacked->unknown_3;
-    packed[4] = unpacked->name_length;
-    memcpy(&packed[5], unpacked->name, sizeof(unpacked->name));
-    packed[21] = unpacked->checksum;
+    UNIFYING_PAIR_REQUEST_3_FIELDS(UNIFYING_PACK_FIELD)
 }
 
+#define UNIFYING_PAIR_RESPONSE_3_FIELDS(FIELD) \
+    FIELD(UINT8, unknown_0, 0)                 \
+    FIELD(UINT8, frame, 1)                     \
+    FIELD(UINT8, step, 2)                      \
+    FIELD(BYTES, unknown_3_8, 3)               \
+    FIELD(UINT8, checksum, 9)
+
 void unifying_pair_response_3_unpack(struct unifying_pair_response_3* unpacked,
                                      const uint8_t packed[UNIFYING_PAIR_RESPONSE_3_LEN])
 {
-    unpacked->unknown_0 = packed[0];
-    unpacked->frame = packed[1];
-    unpacked->step = packed[2];
-    memcpy(unpacked->unknown_3_8, &packed[3], sizeof(unpacked->unknown_3_8));
-    unpacked->checksum = packed[9];
+    UNIFYING_PAIR_RESPONSE_3_FIELDS(UNIFYING_UNPACK_FIELD)
 }
 
 void unifying_pair_complete_request_init(struct unifying_pair_complete_request* unpacked)
@@ -138,15 +196,18 @@ void unifying_pair_complete_request_init(struct unifying_pair_complete_request*
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_pair_complete_request));
 }
 
+#define UNIFYING_PAIR_COMPLETE_REQUEST_FIELDS(FIELD) \
+    FIELD(UINT8, unknown_0, 0)                       \
+    FIELD(UINT8, frame, 1)                           \
+    FIELD(UINT8, step, 2)                            \
+    FIELD(UINT8, unknown_3, 3)                       \
+    FIELD(BYTES, unknown_4_8, 4)                     \
+    FIELD(UINT8, checksum, 9)
+
 void unifying_pair_complete_request_pack(uint8_t packed[UNIFYING_PAIR_COMPLETE_REQUEST_LEN],
                                          const struct unifying_pair_complete_request* unpacked)
 {
-    packed[0] = unpacked->unknown_0;
-    packed[1] = unpacked->frame;
-    packed[2] = unpacked->step;
-    packed[3] = unpacked->unknown_3;
-    memcpy(&packed[4], unpacked->unknown_4_8, sizeof(unpacked->unknown_4_8));
-    packed[9] = unpacked->checksum;
+    UNIFYING_PAIR_COMPLETE_REQUEST_FIELDS(UNIFYING_PACK_FIELD)
 }
 
 
@@ -164,17 +225,20 @@ void unifying_long_wake_up_request_init(struct unifying_long_wake_up_request* un
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_long_wake_up_request));
 }
 
+#define UNIFYING_LONG_WAKE_UP_REQUEST_FIELDS(FIELD) \
+    FIELD(UINT8, index, 0)                          \
+    FIELD(UINT8, frame, 1)                          \
+    FIELD(UINT8, index_2, 2)                        \
+    FIELD(UINT8, unknown_3, 3)                      \
+    FIELD(UINT8, unknown_4, 4)                      \
+    FIELD(BYTES, unknown_5_7, 5)                    \
+    FIELD(BYTES, unknown_8_20, 8)                   \
+    FIELD(UINT8, checksum, 21)
+
 void unifying_long_wake_up_request_pack(uint8_t packed[UNIFYING_LONG_WAKE_UP_REQUEST_LEN],
                                      const struct unifying_long_wake_up_request* unpacked)
 {
-    packed[0] = unpacked->index;
-    packed[1] = unpacked->frame;
-    packed[2] = unpacked->index_2;
-    packed[3] = unpacked->unknown_3;
-    packed[4] = unpacked->unknown_4;
-    memcpy(&packed[5], unpacked->unknown_5_7, sizeof(unpacked->unknown_5_7));
-    memcpy(&packed[8], unpacked->unknown_8_20, sizeof(unpacked->unknown_8_20));
-    packed[21] = unpacked->checksum;
+    UNIFYING_LONG_WAKE_UP_REQUEST_FIELDS(UNIFYING_PACK_FIELD)
 }
 
 
@@ -190,16 +254,19 @@ void unifying_short_wake_up_request_init(struct unifying_short_wake_up_request*
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_short_wake_up_request));
 }
 
+#define UNIFYING_SHORT_WAKE_UP_REQUEST_FIELDS(FIELD) \
+    FIELD(UINT8, index, 0)                           \
+    FIELD(UINT8, frame, 1)                           \
+    FIELD(UINT8, unknown_2, 2)                       \
+    FIELD(UINT8, unknown_3, 3)                       \
+    FIELD(UINT8, unknown_4, 4)                       \
+    FIELD(BYTES, unknown_5_8, 5)                     \
+    FIELD(UINT8, checksum, 9)
+
 void unifying_short_wake_up_request_pack(uint8_t packed[UNIFYING_SHORT_WAKE_UP_REQUEST_LEN],
                                      const struct unifying_short_wake_up_request* unpacked)
 {
-    packed[0] = unpacked->index;
-    packed[1] = unpacked->frame;
-    packed[2] = unpacked->unknown_2;
-    packed[3] = unpacked->unknown_3;
-    packed[4] = unpacked->unknown_4;
-    memcpy(&packed[5], unpacked->unknown_5_8, sizeof(unpacked->unknown_5_8));
-    packed[9] = unpacked->checksum;
+    UNIFYING_SHORT_WAKE_UP_REQUEST_FIELDS(UNIFYING_PACK_FIELD)
 }
 
 
@@ -212,15 +279,18 @@ void unifying_set_timeout_request_init(struct unifying_set_timeout_request* unpa
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_set_timeout_request));
 }
 
+#define UNIFYING_SET_TIMEOUT_REQUEST_FIELDS(FIELD) \
+    FIELD(UINT8, unknown_0, 0)                     \
+    FIELD(UINT8, frame, 1)                         \
+    FIELD(UINT8, unknown_2, 2)                     \
+    FIELD(UINT16, timeout, 3)                      \
+    FIELD(BYTES, unknown_5_8, 5)                   \
+    FIELD(UINT8, checksum, 9)
+
 void unifying_set_timeout_request_pack(uint8_t packed[UNIFYING_SET_TIMEOUT_REQUEST_LEN],
                                        const struct unifying_set_timeout_request* unpacked)
 {
-    packed[0] = unpacked->unknown_0;
-    packed[1] = unpacked->frame;
-    packed[2] = unpacked->unknown_2;
-    unifying_uint16_pack(&packed[3], unpacked->timeout);
-    memcpy(&packed[5], unpacked->unknown_5_8, sizeof(unpacked->unknown_5_8));
-    packed[9] = unpacked->checksum;
+    UNIFYING_SET_TIMEOUT_REQUEST_FIELDS(UNIFYING_PACK_FIELD)
 }
 
 
@@ -233,13 +303,16 @@ void unifying_keep_alive_request_init(struct unifying_keep_alive_request* unpack
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_keep_alive_request));
 }
 
+#define UNIFYING_KEEP_ALIVE_REQUEST_FIELDS(FIELD) \
+    FIELD(UINT8, unknown_0, 0)                    \
+    FIELD(UINT8, frame, 1)                        \
+    FIELD(UINT16, timeout, 2)                     \
+    FIELD(UINT8, checksum, 4)
+
 void unifying_keep_alive_request_pack(uint8_t packed[UNIFYING_KEEP_ALIVE_REQUEST_LEN],
                                      const struct unifying_keep_alive_request* unpacked)
 {
-    packed[0] = unpacked->unknown_0;
-    packed[1] = unpacked->frame;
-    unifying_uint16_pack(&packed[2], unpacked->timeout);
-    packed[4] = unpacked->checksum;
+    UNIFYING_KEEP_ALIVE_REQUEST_FIELDS(UNIFYING_PACK_FIELD)
 }
 
 
@@ -257,28 +330,25 @@ void unifying_hidpp_1_0_short_init(struct unifying_hidpp_1_0_short* unpacked,
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_hidpp_1_0_short));
 }
 
+#define UNIFYING_HIDPP_1_0_SHORT_FIELDS(FIELD) \
+    FIELD(UINT8, unknown_0, 0)                 \
+    FIELD(UINT8, report, 1)                    \
+    FIELD(UINT8, index, 2)                     \
+    FIELD(UINT8, sub_id, 3)                    \
+    FIELD(BYTES, params, 4)                    \
+    FIELD(UINT8, unknown_8, 8)                 \
+    FIELD(UINT8, checksum, 9)
+
 void unifying_hidpp_1_0_short_pack(uint8_t packed[UNIFYING_HIDPP_1_0_SHORT_LEN],
                                   const struct unifying_hidpp_1_0_short* unpacked)
 {
-    packed[0] = unpacked->unknown_0;
-    packed[1] = unpacked->report;
-    packed[2] = unpacked->index;
-    packed[3] = unpacked->sub_id;
-    memcpy(&packed[4], unpacked->params, sizeof(unpacked->params));
-    packed[8] = unpacked->unknown_8;
-    packed[9] = unpacked->checksum;
+    UNIFYING_HIDPP_1_0_SHORT_FIELDS(UNIFYING_PACK_FIELD)
 }
 
 void unifying_hidpp_1_0_short_unpack(struct unifying_hidpp_1_0_short* unpacked,
                                      const uint8_t packed[UNIFYING_HIDPP_1_0_SHORT_LEN])
 {
-    unpacked->unknown_0 = packed[0];
-    unpacked->report = packed[1];
-    unpacked->index = packed[2];
-    unpacked->sub_id = packed[3];
-    memcpy(unpacked->params, &packed[4], sizeof(unpacked->params));
-    unpacked->unknown_8 = packed[8];
-    unpacked->checksum = packed[9];
+    UNIFYING_HIDPP_1_0_SHORT_FIELDS(UNIFYING_UNPACK_FIELD)
 }
 
 
@@ -296,26 +366,24 @@ void unifying_hidpp_1_0_long_init(struct unifying_hidpp_1_0_long* unpacked,
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_hidpp_1_0_long));
 }
 
+#define UNIFYING_HIDPP_1_0_LONG_FIELDS(FIELD) \
+    FIELD(UINT8, unknown_0, 0)                \
+    FIELD(UINT8, report, 1)                   \
+    FIELD(UINT8, index, 2)                    \
+    FIELD(UINT8, sub_id, 3)                   \
+    FIELD(BYTES, params, 4)                   \
+    FIELD(UINT8, checksum, 21)
+
 void unifying_hidpp_1_0_long_pack(uint8_t packed[UNIFYING_HIDPP_1_0_LONG_LEN],
                                  const struct unifying_hidpp_1_0_long* unpacked)
 {
-    packed[0] = unpacked->unknown_0;
-    packed[1] = unpacked->report;
-    packed[2] = unpacked->index;
-    packed[3] = unpacked->sub_id;
-    memcpy(&packed[4], unpacked->params, sizeof(unpacked->params));
-    packed[9] = unpacked->checksum;
+    UNIFYING_HIDPP_1_0_LONG_FIELDS(UNIFYING_PACK_FIELD)
 }
 
 void unifying_hidpp_1_0_long_unpack(struct unifying_hidpp_1_0_long* unpacked,
                                      const uint8_t packed[UNIFYING_HIDPP_1_0_LONG_LEN])
 {
-    unpacked->unknown_0 = packed[0];
-    unpacked->report = packed[1];
-    unpacked->index = packed[2];
-    unpacked->sub_id = packed[3];
-    memcpy(unpacked->params, &packed[4], sizeof(unpacked->params));
-    unpacked->checksum = packed[9];
+    UNIFYING_HIDPP_1_0_LONG_FIELDS(UNIFYING_UNPACK_FIELD)
 }
 
 
@@ -331,15 +399,18 @@ void unifying_encrypted_keystroke_request_init(struct unifying_encrypted_keystro
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_encrypted_keystroke_request));
 }
 
+#define UNIFYING_ENCRYPTED_KEYSTROKE_REQUEST_FIELDS(FIELD) \
+    FIELD(UINT8, unknown_0, 0)                             \
+    FIELD(UINT8, frame, 1)                                 \
+    FIELD(BYTES, ciphertext, 2)                            \
+    FIELD(UINT32, counter, 10)                             \
+    FIELD(BYTES, unknown_14_20, 14)                        \
+    FIELD(UINT8, checksum, 21)
+
 void unifying_encrypted_keystroke_request_pack(uint8_t packed[UNIFYING_ENCRYPTED_KEYSTROKE_REQUEST_LEN],
                                                const struct unifying_encrypted_keystroke_request* unpacked)
 {
-    packed[0] = unpacked->unknown_0;
-    packed[1] = unpacked->frame;
-    memcpy(&packed[2], unpacked->ciphertext, sizeof(unpacked->ciphertext));
-    unifying_uint32_pack(&packed[10], unpacked->counter);
-    memcpy(&packed[14], unpacked->unknown_14_20, sizeof(unpacked->unknown_14_20));
-    packed[21] = unpacked->checksum;
+    UNIFYING_ENCRYPTED_KEYSTROKE_REQUEST_FIELDS(UNIFYING_PACK_FIELD)
 }
 
 void unifying_multimeia_keystroke_request_init(struct unifying_multimeia_keystroke_request* unpacked,
@@ -351,14 +422,17 @@ void unifying_multimeia_keystroke_request_init(struct unifying_multimeia_keystro
     unpacked->checksum = unifying_checksum((uint8_t*) unpacked, sizeof(struct unifying_multimeia_keystroke_request));
 }
 
+#define UNIFYING_MULTIMEDIA_KEYSTROKE_REQUEST_FIELDS(FIELD) \
+    FIELD(UINT8, unknown_0, 0)                              \
+    FIELD(UINT8, frame, 1)                                  \
+    FIELD(BYTES, keys, 2)                                   \
+    FIELD(BYTES, unknown_6_8, 6)                            \
+    FIELD(UINT8, checksum, 9)
+
 void unifying_multimeia_keystroke_request_pack(uint8_t packed[UNIFYING_MULTIMEDIA_KEYSTROKE_REQUEST_LEN],
                                                const struct unifying_multimeia_keystroke_request* unpacked)
 {
-    packed[0] = unpacked->unknown_0;
-    packed[1] = unpacked->frame;
-    memcpy(&packed[2], unpacked->keys, sizeof(unpacked->keys));
-    memcpy(&packed[6], unpacked->unknown_6_8, sizeof(unpacked->unknown_6_8));
-    packed[9] = unpacked->checksum;
+    UNIFYING_MULTIMEDIA_KEYSTROKE_REQUEST_FIELDS(UNIFYING_PACK_FIELD)
 }
 
 void unifying_mouse_request_init(struct unifying_mouse_request* unpacked,
@@ -396,7 +470,7 @@ void unifying_mouse_request_pack(uint8_t packed[UNIFYING_MOUSE_REQUEST_LEN],
     //  |
     //  '- bytes 0-7 of Y axis movement
     packed[4] = unpacked->move_y & 0xFF;
-    packed[5] = ((unpacked->move_y >> 8) & 0x0F) | ((unpacked->move_x << 4) & 0xF0);
+    packed[5] = ((unpacked->move_y >> 8) & 0x0F) | (((uint16_t)unpacked->move_x << 4) & 0xF0);
     packed[6] = (unpacked->move_x >> 4) & 0xFF;
 
     packed[7] = unpacked->wheel_y;
@@ -404,4 +478,23 @@ void unifying_mouse_request_pack(uint8_t packed[UNIFYING_MOUSE_REQUEST_LEN],
     packed[9] = unifying_checksum(packed, UNIFYING_MOUSE_REQUEST_LEN - 1);
 }
 
+void unifying_mouse_request_unpack(struct unifying_mouse_request* unpacked,
+                                   const uint8_t packed[UNIFYING_MOUSE_REQUEST_LEN])
+{
+    unpacked->unknown_0 = packed[0];
+    unpacked->frame = packed[1];
+    unpacked->buttons = packed[2];
+    unpacked->unknown_3 = packed[3];
+
+    // Reverse the 12-bit packing done by unifying_mouse_request_pack() and sign extend the result.
+    uint16_t move_y = packed[4] | ((packed[5] & 0x0F) << 8);
+    uint16_t move_x = ((packed[5] >> 4) & 0x0F) | (packed[6] << 4);
+    unpacked->move_y = (move_y & 0x0800) ? (int16_t)(move_y | 0xF000) : (int16_t)move_y;
+    unpacked->move_x = (move_x & 0x0800) ? (int16_t)(move_x | 0xF000) : (int16_t)move_x;
+
+    unpacked->wheel_y = packed[7];
+    unpacked->wheel_x = packed[8];
+    unpacked->checksum = packed[9];
+}
+
 
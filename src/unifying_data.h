@@ -663,6 +663,15 @@ void unifying_mouse_request_init(struct unifying_mouse_request* unpacked,
 void unifying_mouse_request_pack(uint8_t packed[UNIFYING_MOUSE_REQUEST_LEN],
                                       const struct unifying_mouse_request* unpacked);
 
+/*!
+ * Unpack a byte array into a \ref unifying_mouse_request.
+ * 
+ * \param[out]  unpacked    Pointer to a \ref unifying_mouse_request to unpack into.
+ * \param[in]   packed      Pointer to byte array that is at least \ref UNIFYING_MOUSE_REQUEST_LEN bytes long.
+ */
+void unifying_mouse_request_unpack(struct unifying_mouse_request* unpacked,
+                                   const uint8_t packed[UNIFYING_MOUSE_REQUEST_LEN]);
+
 
 #ifdef __cplusplus
 }
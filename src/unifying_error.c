@@ -19,6 +19,10 @@ const char* unifying_error_name[UNIFYING_ERROR_COUNT] = {
     "BUFFER_FULL_ERROR",
     "BUFFER_EMPTY_ERROR",
     "CREATE_ERROR",
+    "BUSY_ERROR",
+    "TIMEOUT_ERROR",
+    "VERSION_ERROR",
+    "COUNTER_LEASE_ERROR",
 };
 
 const char* unifying_error_message[UNIFYING_ERROR_COUNT] = {
@@ -39,6 +43,10 @@ const char* unifying_error_message[UNIFYING_ERROR_COUNT] = {
     "Buffer was full when it was expected to not be full",
     "Buffer was empty when it was expected to not be empty",
     "Failed to create a dynamically allocated object",
+    "An operation that was started earlier has not finished yet",
+    "Timed out waiting for a response",
+    "Stored data has a version that isn't supported",
+    "The AES counter reached the end of its lease",
 };
 
 const char* unifying_get_error_name(enum unifying_error err)
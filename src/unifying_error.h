@@ -50,6 +50,14 @@ enum unifying_error {
     UNIFYING_BUFFER_EMPTY_ERROR,
     /// Failed to create a dynamically allocated object.
     UNIFYING_CREATE_ERROR,
+    /// An operation that was started earlier has not finished yet.
+    UNIFYING_BUSY_ERROR,
+    /// Timed out waiting for a response.
+    UNIFYING_TIMEOUT_ERROR,
+    /// Stored data has a version that isn't supported.
+    UNIFYING_VERSION_ERROR,
+    /// The AES counter reached the end of its lease.
+    UNIFYING_COUNTER_LEASE_ERROR,
     /// The number of errors that have been defined
     UNIFYING_ERROR_COUNT,
 };
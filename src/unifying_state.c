@@ -1,5 +1,6 @@
 
 #include "unifying_state.h"
+#include "unifying_utils.h"
 
 #if defined(UNIFYING_HARDWARE_AES) && (UNIFYING_HARDWARE_AES == 0)
 static uint8_t unifying_encrypt(uint8_t data[UNIFYING_AES_DATA_LEN],
@@ -10,6 +11,133 @@ static uint8_t unifying_encrypt(uint8_t data[UNIFYING_AES_DATA_LEN],
   AES_CTR_xcrypt_buffer(&ctx, data, UNIFYING_AES_DATA_LEN);
   return 0;
 }
+
+static uint8_t unifying_prepare_key(struct unifying_aes_context* context,
+                                    const uint8_t key[UNIFYING_AES_BLOCK_LEN]) {
+  AES_init_ctx(&context->aes, key);
+  return 0;
+}
+
+static uint8_t unifying_encrypt_prepared(uint8_t data[UNIFYING_AES_DATA_LEN],
+                                         struct unifying_aes_context* context,
+                                         const uint8_t iv[UNIFYING_AES_BLOCK_LEN]) {
+  AES_ctx_set_iv(&context->aes, iv);
+  AES_CTR_xcrypt_buffer(&context->aes, data, UNIFYING_AES_DATA_LEN);
+  return 0;
+}
+
+static uint8_t unifying_encrypt_prepared_batch(uint8_t data[][UNIFYING_AES_DATA_LEN],
+                                               struct unifying_aes_context* const contexts[],
+                                               const uint8_t iv[][UNIFYING_AES_BLOCK_LEN],
+                                               uint8_t count) {
+#if defined(ECB) && (ECB == 1)
+  struct AES_ctx* ctx[UNIFYING_ENCRYPT_BATCH_LEN] = {0};
+  uint8_t keystream[UNIFYING_ENCRYPT_BATCH_LEN][UNIFYING_AES_BLOCK_LEN];
+
+  for(uint8_t i = 0; i < count; i++) {
+    ctx[i] = &contexts[i]->aes;
+    memcpy(keystream[i], iv[i], UNIFYING_AES_BLOCK_LEN);
+  }
+
+  // Counter mode with a single block per IV is just ECB encryption of the IVs.
+  AES_ECB_encrypt_blocks(ctx, &keystream[0][0], count);
+
+  for(uint8_t i = 0; i < count; i++) {
+    for(uint8_t j = 0; j < UNIFYING_AES_DATA_LEN; j++) {
+      data[i][j] ^= keystream[i][j];
+    }
+  }
+#else
+  // Without ECB mode the blocks can't be encrypted in lockstep.
+  for(uint8_t i = 0; i < count; i++) {
+    unifying_encrypt_prepared(data[i], contexts[i], iv[i]);
+  }
+#endif
+
+  return 0;
+}
+#endif
+
+#if defined(UNIFYING_AES_NI) && (UNIFYING_AES_NI == 1)
+#include <cpuid.h>
+#include <wmmintrin.h>
+
+static bool unifying_aes_ni_supported() {
+  unsigned int eax, ebx, ecx, edx;
+
+  if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+
+  return (ecx & bit_AES) != 0;
+}
+
+// The key schedule is still expanded by Tiny AES.
+// Its round keys are stored in the byte order that AESENC expects.
+__attribute__((target("aes,sse2")))
+static uint8_t unifying_encrypt_prepared_aes_ni(uint8_t data[UNIFYING_AES_DATA_LEN],
+                                                struct unifying_aes_context* context,
+                                                const uint8_t iv[UNIFYING_AES_BLOCK_LEN]) {
+  const __m128i* round_keys = (const __m128i*) context->aes.RoundKey;
+  uint8_t keystream[UNIFYING_AES_BLOCK_LEN];
+
+  __m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i*) iv), _mm_loadu_si128(&round_keys[0]));
+
+  for(uint8_t round = 1; round < 10; round++) {
+    block = _mm_aesenc_si128(block, _mm_loadu_si128(&round_keys[round]));
+  }
+
+  block = _mm_aesenclast_si128(block, _mm_loadu_si128(&round_keys[10]));
+  _mm_storeu_si128((__m128i*) keystream, block);
+
+  for(uint8_t i = 0; i < UNIFYING_AES_DATA_LEN; i++) {
+    data[i] ^= keystream[i];
+  }
+
+  return 0;
+}
+
+// Every block uses its own key schedule so all of them can be in flight at once.
+__attribute__((target("aes,sse2")))
+static uint8_t unifying_encrypt_prepared_batch_aes_ni(uint8_t data[][UNIFYING_AES_DATA_LEN],
+                                                      struct unifying_aes_context* const contexts[],
+                                                      const uint8_t iv[][UNIFYING_AES_BLOCK_LEN],
+                                                      uint8_t count) {
+  __m128i block[UNIFYING_ENCRYPT_BATCH_LEN];
+  uint8_t keystream[UNIFYING_AES_BLOCK_LEN];
+
+  for(uint8_t i = 0; i < count; i++) {
+    const __m128i* round_keys = (const __m128i*) contexts[i]->aes.RoundKey;
+    block[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i*) iv[i]), _mm_loadu_si128(&round_keys[0]));
+  }
+
+  for(uint8_t round = 1; round < 10; round++) {
+    for(uint8_t i = 0; i < count; i++) {
+      const __m128i* round_keys = (const __m128i*) contexts[i]->aes.RoundKey;
+      block[i] = _mm_aesenc_si128(block[i], _mm_loadu_si128(&round_keys[round]));
+    }
+  }
+
+  for(uint8_t i = 0; i < count; i++) {
+    const __m128i* round_keys = (const __m128i*) contexts[i]->aes.RoundKey;
+    block[i] = _mm_aesenclast_si128(block[i], _mm_loadu_si128(&round_keys[10]));
+    _mm_storeu_si128((__m128i*) keystream, block[i]);
+
+    for(uint8_t j = 0; j < UNIFYING_AES_DATA_LEN; j++) {
+      data[i][j] ^= keystream[j];
+    }
+  }
+
+  return 0;
+}
+
+static uint8_t unifying_encrypt_aes_ni(uint8_t data[UNIFYING_AES_DATA_LEN],
+                                       const uint8_t key[UNIFYING_AES_BLOCK_LEN],
+                                       const uint8_t iv[UNIFYING_AES_BLOCK_LEN]) {
+  struct unifying_aes_context context;
+  unifying_prepare_key(&context, key);
+  return unifying_encrypt_prepared_aes_ni(data, &context, iv);
+}
 #endif
 
 enum unifying_error unifying_interface_init(struct unifying_interface* interface,
@@ -28,6 +156,17 @@ enum unifying_error unifying_interface_init(struct unifying_interface* interface
     {
 #if defined(UNIFYING_HARDWARE_AES) && (UNIFYING_HARDWARE_AES == 0)
         interface->encrypt = unifying_encrypt;
+        interface->prepare_key = unifying_prepare_key;
+        interface->encrypt_prepared = unifying_encrypt_prepared;
+        interface->encrypt_prepared_batch = unifying_encrypt_prepared_batch;
+#if defined(UNIFYING_AES_NI) && (UNIFYING_AES_NI == 1)
+        if(unifying_aes_ni_supported())
+        {
+            interface->encrypt = unifying_encrypt_aes_ni;
+            interface->encrypt_prepared = unifying_encrypt_prepared_aes_ni;
+            interface->encrypt_prepared_batch = unifying_encrypt_prepared_batch_aes_ni;
+        }
+#endif
 #else
         return UNIFYING_ERROR;
 #endif
@@ -35,6 +174,9 @@ enum unifying_error unifying_interface_init(struct unifying_interface* interface
     else
     {
         interface->encrypt = encrypt;
+        interface->prepare_key = NULL;
+        interface->encrypt_prepared = NULL;
+        interface->encrypt_prepared_batch = NULL;
     }
 
     interface->transmit_payload = transmit_payload;
@@ -44,11 +186,39 @@ enum unifying_error unifying_interface_init(struct unifying_interface* interface
     interface->set_address = set_address;
     interface->set_channel = set_channel;
     interface->time = time;
+    interface->wait_until = NULL;
 
     return UNIFYING_SUCCESS;
 }
 
+void unifying_interface_encrypt_prepared_set(struct unifying_interface* interface,
+                                             uint8_t (*prepare_key)(struct unifying_aes_context* context,
+                                                                    const uint8_t key[UNIFYING_AES_BLOCK_LEN]),
+                                             uint8_t (*encrypt_prepared)(uint8_t data[UNIFYING_AES_DATA_LEN],
+                                                                         struct unifying_aes_context* context,
+                                                                         const uint8_t iv[UNIFYING_AES_BLOCK_LEN]),
+                                             uint8_t (*encrypt_prepared_batch)(
+                                                 uint8_t data[][UNIFYING_AES_DATA_LEN],
+                                                 struct unifying_aes_context* const contexts[],
+                                                 const uint8_t iv[][UNIFYING_AES_BLOCK_LEN],
+                                                 uint8_t count))
+{
+    interface->prepare_key = prepare_key;
+    interface->encrypt_prepared = encrypt_prepared;
+    interface->encrypt_prepared_batch = encrypt_prepared_batch;
+}
+
+void unifying_interface_wait_until_set(struct unifying_interface* interface, void (*wait_until)(uint32_t deadline))
+{
+    interface->wait_until = wait_until;
+}
+
+
 
+const struct unifying_idle_step unifying_default_idle_ladder[UNIFYING_DEFAULT_IDLE_LADDER_LEN] = {
+    {500, 110},
+    {10000, 1200},
+};
 
 void unifying_state_init(struct unifying_state* state,
                          const struct unifying_interface* interface,
@@ -61,32 +231,186 @@ void unifying_state_init(struct unifying_state* state,
                          uint8_t channel)
 {
     state->transmit_buffer = transmit_buffer;
+    unifying_ring_buffer_init(&state->control_buffer,
+                              state->control_entries,
+                              sizeof(struct unifying_transmit_entry),
+                              UNIFYING_CONTROL_BUFFER_LEN);
+    memset(&state->mouse_carry, 0, sizeof(state->mouse_carry));
     state->receive_buffer = receive_buffer;
     state->interface = interface;
     state->address = address;
     state->aes_key = aes_key;
     state->aes_counter = aes_counter;
+    state->aes_counter_lease = 0;
+    state->aes_counter_lease_slot = UNIFYING_COUNTER_LEASE_SLOTS - 1;
+    state->aes_counter_leased = false;
+    state->aes_context_valid = false;
+#if UNIFYING_KEYSTREAM_LEN
+    state->keystream_counter = aes_counter;
+    state->keystream_front = 0;
+    state->keystream_count = 0;
+#endif
     state->default_timeout = default_timeout;
     state->timeout = default_timeout;
-    state->previous_transmit = 0;
-    state->next_transmit = 0;
+    state->idle_ladder = unifying_default_idle_ladder;
+    state->idle_ladder_len = UNIFYING_DEFAULT_IDLE_LADDER_LEN;
+    state->idle_step = 0;
+    // Times are compared by their difference so they must start out near the current time.
+    state->last_activity = interface->time();
+    state->previous_transmit = state->last_activity;
+    state->next_transmit = state->last_activity;
+    state->hidpp_registers = NULL;
+    memset(state->hidpp_register_slots, 0, UNIFYING_HIDPP_1_0_REGISTER_SLOTS);
+    memset(state->hidpp_name_responses, 0, sizeof(state->hidpp_name_responses));
+    state->hidpp_name_responses[2][0] = UNIFYING_HIDPP_2_0_DEVICE_TYPE;
+    state->hidpp_failures = 0;
+    state->hidpp_retry = state->last_activity;
+    state->hidpp_features_len = 0;
+    unifying_state_hidpp_feature_add(state, &(struct unifying_hidpp_2_0_feature) {
+        .id = UNIFYING_HIDPP_2_0_FEATURE_ROOT,
+    });
+    unifying_state_hidpp_feature_add(state, &(struct unifying_hidpp_2_0_feature) {
+        .id = UNIFYING_HIDPP_2_0_FEATURE_FEATURE_SET,
+    });
+    unifying_state_hidpp_feature_add(state, &(struct unifying_hidpp_2_0_feature) {
+        .id = UNIFYING_HIDPP_2_0_FEATURE_DEVICE_NAME_TYPE,
+        .responses = (const uint8_t (*)[UNIFYING_HIDPP_2_0_RESPONSE_LEN]) state->hidpp_name_responses,
+        .functions_len = 3,
+    });
+    memset(state->keyboard_keys, 0, UNIFYING_KEYS_LEN);
+    state->keyboard_modifiers = 0;
+    state->pairing.step = UNIFYING_PAIR_STEP_IDLE;
+    state->pairing.result = UNIFYING_PAIR_ERROR;
+
+    for(uint8_t i = 0; i < UNIFYING_PAIRING_CHANNELS_LEN; i++)
+    {
+        state->pairing.channel_order[i] = i;
+    }
+
     state->channel = channel;
+
+    for(uint8_t i = 0; i < UNIFYING_CHANNELS_LEN; i++)
+    {
+        state->channel_stats[i].successes = 0;
+        state->channel_stats[i].failures = 0;
+        state->channel_stats[i].quality = UNIFYING_CHANNEL_QUALITY_UNKNOWN;
+    }
+
+    state->channels_tried = 0;
 }
 
-void unifying_state_transmit_buffer_clear(struct unifying_state* state)
+void unifying_state_idle_ladder_set(struct unifying_state* state,
+                                    const struct unifying_idle_step* ladder,
+                                    uint8_t length)
+{
+    state->idle_ladder = ladder;
+    state->idle_ladder_len = ladder ? length : 0;
+    state->idle_step = 0;
+}
+
+/*!
+ * Get the first slot to look in for a HID++ 1.0 register.
+ * 
+ * \param[in]   address     Register address.
+ * 
+ * \return  Index into \ref unifying_state.hidpp_register_slots "state.hidpp_register_slots".
+ */
+static uint8_t unifying_hidpp_register_slot(uint8_t address)
 {
-    while(!unifying_ring_buffer_empty(state->transmit_buffer))
+    // Fold the high nibble in so that registers like 0x00 and 0xF0 don't collide.
+    return (address ^ (address >> 4)) & (UNIFYING_HIDPP_1_0_REGISTER_SLOTS - 1);
+}
+
+enum unifying_error unifying_state_hidpp_registers_set(struct unifying_state* state,
+                                                       const struct unifying_hidpp_1_0_register* registers,
+                                                       uint8_t length)
+{
+    if(!registers)
+    {
+        length = 0;
+    }
+
+    // Leave at least one slot empty so that looking up a missing register always stops.
+    if(length >= UNIFYING_HIDPP_1_0_REGISTER_SLOTS)
     {
-        unifying_transmit_entry_destroy(unifying_ring_buffer_pop_front(state->transmit_buffer));
+        return UNIFYING_BUFFER_FULL_ERROR;
     }
+
+    state->hidpp_registers = registers;
+    memset(state->hidpp_register_slots, 0, UNIFYING_HIDPP_1_0_REGISTER_SLOTS);
+
+    for(uint8_t i = 0; i < length; i++)
+    {
+        uint8_t slot = unifying_hidpp_register_slot(registers[i].address);
+
+        while(state->hidpp_register_slots[slot])
+        {
+            slot = (slot + 1) & (UNIFYING_HIDPP_1_0_REGISTER_SLOTS - 1);
+        }
+
+        state->hidpp_register_slots[slot] = i + 1;
+    }
+
+    return UNIFYING_SUCCESS;
 }
 
-void unifying_state_receive_buffer_clear(struct unifying_state* state)
+const struct unifying_hidpp_1_0_register* unifying_state_hidpp_register(const struct unifying_state* state,
+                                                                        uint8_t address)
+{
+    uint8_t slot = unifying_hidpp_register_slot(address);
+
+    while(state->hidpp_register_slots[slot])
+    {
+        const struct unifying_hidpp_1_0_register* hidpp_register =
+            &state->hidpp_registers[state->hidpp_register_slots[slot] - 1];
+
+        if(hidpp_register->address == address)
+        {
+            return hidpp_register;
+        }
+
+        slot = (slot + 1) & (UNIFYING_HIDPP_1_0_REGISTER_SLOTS - 1);
+    }
+
+    return NULL;
+}
+
+enum unifying_error unifying_state_hidpp_feature_add(struct unifying_state* state,
+                                                     const struct unifying_hidpp_2_0_feature* feature)
 {
-    while(!unifying_ring_buffer_empty(state->receive_buffer))
+    if(state->hidpp_features_len >= UNIFYING_HIDPP_2_0_FEATURES_LEN)
     {
-        unifying_receive_entry_destroy(unifying_ring_buffer_pop_front(state->receive_buffer));
+        return UNIFYING_BUFFER_FULL_ERROR;
     }
+
+    state->hidpp_features[state->hidpp_features_len++] = *feature;
+    return UNIFYING_SUCCESS;
+}
+
+void unifying_state_name_set(struct unifying_state* state, const char* name, uint8_t length)
+{
+    if(length > UNIFYING_MAX_NAME_LEN)
+    {
+        length = UNIFYING_MAX_NAME_LEN;
+    }
+
+    // The whole name fits in a single getDeviceName response so it is never requested in pieces.
+    memset(state->hidpp_name_responses[0], 0, UNIFYING_HIDPP_2_0_RESPONSE_LEN);
+    memset(state->hidpp_name_responses[1], 0, UNIFYING_HIDPP_2_0_RESPONSE_LEN);
+    state->hidpp_name_responses[0][0] = length;
+    memcpy(state->hidpp_name_responses[1], name, length);
+}
+
+void unifying_state_transmit_buffer_clear(struct unifying_state* state)
+{
+    unifying_ring_buffer_pop_n(state->transmit_buffer, NULL, state->transmit_buffer->size);
+    unifying_ring_buffer_pop_n(&state->control_buffer, NULL, state->control_buffer.size);
+}
+
+void unifying_state_receive_buffer_clear(struct unifying_state* state)
+{
+    unifying_ring_buffer_pop_n(state->receive_buffer, NULL, state->receive_buffer->size);
+    state->hidpp_failures = 0;
 }
 
 void unifying_state_buffers_clear(struct unifying_state* state)
@@ -108,6 +432,230 @@ uint8_t unifying_state_channel_set(struct unifying_state* state, uint8_t channel
     return status;
 }
 
+void unifying_state_channel_record(struct unifying_state* state, bool success)
+{
+    uint8_t index = unifying_channel_index(state->channel);
+
+    if(index >= UNIFYING_CHANNELS_LEN)
+    {
+        return;
+    }
+
+    struct unifying_channel_stats* stats = &state->channel_stats[index];
+
+    if(success)
+    {
+        stats->successes += stats->successes < UINT16_MAX;
+        stats->quality += (0xFF - stats->quality + 3) / 4;
+        state->channels_tried = 0;
+    }
+    else
+    {
+        stats->failures += stats->failures < UINT16_MAX;
+        stats->quality -= (stats->quality + 7) / 8;
+        state->channels_tried |= (uint32_t)1 << index;
+
+        if(state->channels_tried == ((uint32_t)1 << UNIFYING_CHANNELS_LEN) - 1)
+        {
+            // Every channel failed since the last success. Start again.
+            state->channels_tried = 0;
+        }
+    }
+}
+
+uint8_t unifying_state_channel_next(const struct unifying_state* state)
+{
+    uint8_t current = unifying_channel_index(state->channel);
+    // Start the search at the channel after the current one, or the first channel if there isn't a current one.
+    uint8_t index = current < UNIFYING_CHANNELS_LEN ? current : UNIFYING_CHANNELS_LEN - 1;
+    uint8_t best = UNIFYING_CHANNELS_LEN;
+
+    for(uint8_t i = 0; i < UNIFYING_CHANNELS_LEN; i++)
+    {
+        index = index + 1 < UNIFYING_CHANNELS_LEN ? index + 1 : 0;
+
+        if(index != current && !(state->channels_tried & ((uint32_t)1 << index)) &&
+           (best == UNIFYING_CHANNELS_LEN || state->channel_stats[index].quality > state->channel_stats[best].quality))
+        {
+            best = index;
+        }
+    }
+
+    if(best == UNIFYING_CHANNELS_LEN)
+    {
+        // Only the current channel hasn't failed.
+        return state->channel;
+    }
+
+    return unifying_channels[best];
+}
+
+void unifying_state_link_snapshot(const struct unifying_state* state, struct unifying_link_snapshot* snapshot)
+{
+    uint8_t best = 0;
+
+    for(uint8_t i = 0; i < UNIFYING_CHANNELS_LEN; i++)
+    {
+        snapshot->channel_quality[i] = state->channel_stats[i].quality;
+
+        if(state->channel_stats[i].quality > state->channel_stats[best].quality)
+        {
+            best = i;
+        }
+    }
+
+    // The current channel is the last one that worked unless a transmission has failed since.
+    if(!state->channels_tried && unifying_channel_index(state->channel) < UNIFYING_CHANNELS_LEN)
+    {
+        snapshot->channel = state->channel;
+    }
+    else
+    {
+        snapshot->channel = unifying_channels[best];
+    }
+
+    snapshot->timeout = state->timeout;
+}
+
+enum unifying_error unifying_state_link_restore(struct unifying_state* state,
+                                                const struct unifying_link_snapshot* snapshot)
+{
+    if(unifying_channel_index(snapshot->channel) >= UNIFYING_CHANNELS_LEN ||
+       unifying_state_channel_set(state, snapshot->channel))
+    {
+        return UNIFYING_SET_CHANNEL_ERROR;
+    }
+
+    for(uint8_t i = 0; i < UNIFYING_CHANNELS_LEN; i++)
+    {
+        state->channel_stats[i].quality = snapshot->channel_quality[i];
+    }
+
+    state->channels_tried = 0;
+    state->timeout = snapshot->timeout;
+
+    // Continue the idle timeout ladder from the restored timeout,
+    // so queued input doesn't wait for a timeout that the ladder had raised.
+    state->idle_step = 0;
+
+    while(state->idle_step < state->idle_ladder_len &&
+          state->idle_ladder[state->idle_step].timeout <= snapshot->timeout)
+    {
+        state->idle_step++;
+    }
+
+    return UNIFYING_SUCCESS;
+}
+
+void unifying_state_blob_pack(const struct unifying_state* state, uint8_t blob[UNIFYING_STATE_BLOB_LEN])
+{
+    struct unifying_link_snapshot snapshot;
+    uint8_t* packed = blob;
+
+    unifying_state_link_snapshot(state, &snapshot);
+
+    *packed++ = UNIFYING_STATE_BLOB_VERSION;
+    memcpy(packed, state->address, UNIFYING_ADDRESS_LEN);
+    packed += UNIFYING_ADDRESS_LEN;
+    memcpy(packed, state->aes_key, UNIFYING_AES_BLOCK_LEN);
+    packed += UNIFYING_AES_BLOCK_LEN;
+    *packed++ = snapshot.channel;
+    unifying_uint16_pack(packed, snapshot.timeout);
+    packed += 2;
+    memcpy(packed, snapshot.channel_quality, UNIFYING_CHANNELS_LEN);
+    packed += UNIFYING_CHANNELS_LEN;
+    *packed = unifying_checksum(blob, UNIFYING_STATE_BLOB_LEN - 1);
+}
+
+enum unifying_error unifying_state_blob_unpack(uint8_t address[UNIFYING_ADDRESS_LEN],
+                                               uint8_t aes_key[UNIFYING_AES_BLOCK_LEN],
+                                               struct unifying_link_snapshot* snapshot,
+                                               const uint8_t blob[UNIFYING_STATE_BLOB_LEN])
+{
+    const uint8_t* packed = blob;
+
+    if(unifying_checksum_verify(blob, UNIFYING_STATE_BLOB_LEN))
+    {
+        return UNIFYING_CHECKSUM_ERROR;
+    }
+
+    if(*packed++ != UNIFYING_STATE_BLOB_VERSION)
+    {
+        return UNIFYING_VERSION_ERROR;
+    }
+
+    memcpy(address, packed, UNIFYING_ADDRESS_LEN);
+    packed += UNIFYING_ADDRESS_LEN;
+    memcpy(aes_key, packed, UNIFYING_AES_BLOCK_LEN);
+    packed += UNIFYING_AES_BLOCK_LEN;
+    snapshot->channel = *packed++;
+    unifying_uint16_unpack(&snapshot->timeout, packed);
+    packed += 2;
+    memcpy(snapshot->channel_quality, packed, UNIFYING_CHANNELS_LEN);
+    return UNIFYING_SUCCESS;
+}
+
+enum unifying_error unifying_state_counter_lease_load(struct unifying_state* state,
+                                                      const uint8_t slots[UNIFYING_COUNTER_LEASE_SLOTS]
+                                                                         [UNIFYING_COUNTER_LEASE_SLOT_LEN])
+{
+    enum unifying_error err = UNIFYING_CHECKSUM_ERROR;
+
+    for(uint8_t i = 0; i < UNIFYING_COUNTER_LEASE_SLOTS; i++)
+    {
+        uint32_t end;
+
+        // Erased memory fails the checksum. Zeroed memory passes it but no lease ends at 0.
+        if(unifying_checksum_verify(slots[i], UNIFYING_COUNTER_LEASE_SLOT_LEN))
+        {
+            continue;
+        }
+
+        unifying_uint32_unpack(&end, slots[i]);
+
+        if(!end)
+        {
+            continue;
+        }
+
+        // Leases only ever grow so the newest lease ends last, even after the counter wraps.
+        if(err || (int32_t)(end - state->aes_counter) > 0)
+        {
+            state->aes_counter = end;
+            state->aes_counter_lease_slot = i;
+            err = UNIFYING_SUCCESS;
+        }
+    }
+
+    // Nothing past the stored lease is safe to use until a new lease has been written.
+    state->aes_counter_lease = state->aes_counter;
+    state->aes_counter_leased = true;
+    return err;
+}
+
+bool unifying_state_counter_lease_due(const struct unifying_state* state)
+{
+    return state->aes_counter_leased &&
+           (int32_t)(state->aes_counter_lease - state->aes_counter) <= UNIFYING_COUNTER_LEASE_LEN / 2;
+}
+
+uint8_t unifying_state_counter_lease_renew(struct unifying_state* state,
+                                           uint8_t slot[UNIFYING_COUNTER_LEASE_SLOT_LEN])
+{
+    if(!state->aes_counter_leased)
+    {
+        state->aes_counter_lease = state->aes_counter;
+        state->aes_counter_leased = true;
+    }
+
+    state->aes_counter_lease += UNIFYING_COUNTER_LEASE_LEN;
+    state->aes_counter_lease_slot = (state->aes_counter_lease_slot + 1) % UNIFYING_COUNTER_LEASE_SLOTS;
+
+    unifying_uint32_pack(slot, state->aes_counter_lease);
+    slot[UNIFYING_COUNTER_LEASE_SLOT_LEN - 1] = unifying_checksum(slot, UNIFYING_COUNTER_LEASE_SLOT_LEN - 1);
+    return state->aes_counter_lease_slot;
+}
+
 uint8_t unifying_state_address_set(struct unifying_state* state, const uint8_t address[UNIFYING_ADDRESS_LEN])
 {
     uint8_t status = state->interface->set_address(address);
@@ -121,76 +669,294 @@ uint8_t unifying_state_address_set(struct unifying_state* state, const uint8_t a
     return status;
 }
 
-void unifying_transmit_entry_init(struct unifying_transmit_entry* entry,
-                                  uint8_t* payload,
-                                  uint8_t length,
-                                  uint8_t timeout)
+void unifying_state_aes_key_set(struct unifying_state* state, const uint8_t aes_key[UNIFYING_AES_BLOCK_LEN])
 {
-    entry->payload = payload;
-    entry->length = length;
-    entry->timeout = timeout;
+    memcpy(state->aes_key, aes_key, UNIFYING_AES_BLOCK_LEN);
+    unifying_state_aes_key_changed(state);
+}
+
+void unifying_state_aes_key_changed(struct unifying_state* state)
+{
+    state->aes_context_valid = false;
+#if UNIFYING_KEYSTREAM_LEN
+    state->keystream_count = 0;
+#endif
+}
+
+/*!
+ * Prepare \ref unifying_state.aes_context "state.aes_context" if the AES key has changed.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ * 
+ * \return  `0` if the context is ready to use.
+ * \return  The return value of \ref unifying_interface.prepare_key() "prepare_key()" if preparation failed.
+ */
+static uint8_t unifying_state_aes_context_prepare(struct unifying_state* state)
+{
+    if(!state->aes_context_valid)
+    {
+        // The key has changed since the context was last prepared.
+        uint8_t status = state->interface->prepare_key(&state->aes_context, state->aes_key);
+
+        if(status)
+        {
+            return status;
+        }
+
+        state->aes_context_valid = true;
+    }
+
+    return 0;
 }
 
-struct unifying_transmit_entry* unifying_transmit_entry_create(uint8_t length, uint8_t timeout)
+uint8_t unifying_state_encrypt(struct unifying_state* state,
+                               uint8_t data[UNIFYING_AES_DATA_LEN],
+                               const uint8_t iv[UNIFYING_AES_BLOCK_LEN])
 {
-    struct unifying_transmit_entry* entry = malloc(sizeof(struct unifying_transmit_entry));
+    const struct unifying_interface* interface = state->interface;
 
-    if(!entry)
+    if(!interface->prepare_key || !interface->encrypt_prepared)
     {
-        return NULL;
+        return interface->encrypt(data, state->aes_key, iv);
     }
 
-    uint8_t* payload = malloc(length);
+    uint8_t status = unifying_state_aes_context_prepare(state);
 
-    if(!payload)
+    if(status)
     {
-        free(entry);
-        return NULL;
+        return status;
     }
 
-    unifying_transmit_entry_init(entry, payload, length, timeout);
-    return entry;
+    return interface->encrypt_prepared(data, &state->aes_context, iv);
 }
 
-void unifying_transmit_entry_destroy(struct unifying_transmit_entry* entry)
+/*!
+ * Compute the keystream block for an AES counter value.
+ * 
+ * \param[in,out]   state       Unifying state information.
+ * \param[out]      keystream   Buffer of \ref UNIFYING_AES_DATA_LEN bytes to store the keystream in.
+ * \param[in]       counter     AES counter.
+ * 
+ * \return  The return value of unifying_state_encrypt().
+ */
+static uint8_t unifying_state_keystream_compute(struct unifying_state* state,
+                                                uint8_t keystream[UNIFYING_AES_DATA_LEN],
+                                                uint32_t counter)
 {
-    free(entry->payload);
-    free(entry);
+    uint8_t aes_iv[UNIFYING_AES_BLOCK_LEN];
+    struct unifying_encrypted_keystroke_iv iv;
+
+    unifying_encrypted_keystroke_iv_init(&iv, counter);
+    unifying_encrypted_keystroke_iv_pack(aes_iv, &iv);
+
+    // Counter mode encryption of zeros yields the keystream itself.
+    memset(keystream, 0, UNIFYING_AES_DATA_LEN);
+    return unifying_state_encrypt(state, keystream, aes_iv);
 }
 
+#if UNIFYING_KEYSTREAM_LEN
+/*!
+ * Discard precomputed keystream blocks that belong to AES counter values
+ * older than \ref unifying_state.aes_counter "state.aes_counter".
+ * 
+ * \param[in,out]   state   Unifying state information.
+ */
+static void unifying_state_keystream_sync(struct unifying_state* state)
+{
+    // This wraps around to a large value if the counter was moved backwards.
+    uint32_t used = state->aes_counter - state->keystream_counter;
+
+    if(used >= state->keystream_count)
+    {
+        state->keystream_front = 0;
+        state->keystream_count = 0;
+    }
+    else
+    {
+        state->keystream_front = (state->keystream_front + used) % UNIFYING_KEYSTREAM_LEN;
+        state->keystream_count -= used;
+    }
 
+    state->keystream_counter = state->aes_counter;
+}
+#endif
 
-void unifying_receive_entry_init(struct unifying_receive_entry* entry,
-                                         uint8_t* payload,
-                                         uint8_t length)
+uint8_t unifying_state_keystream_fill(struct unifying_state* state)
 {
-    entry->payload = payload;
-    entry->length = length;
+#if UNIFYING_KEYSTREAM_LEN
+    unifying_state_keystream_sync(state);
+
+    if(state->keystream_count >= UNIFYING_KEYSTREAM_LEN)
+    {
+        return 0;
+    }
+
+    uint8_t index = (state->keystream_front + state->keystream_count) % UNIFYING_KEYSTREAM_LEN;
+    uint8_t status = unifying_state_keystream_compute(state,
+                                                      state->keystream[index],
+                                                      state->keystream_counter + state->keystream_count);
+
+    if(status)
+    {
+        return status;
+    }
+
+    state->keystream_count += 1;
+#else
+    (void) state;
+#endif
+    return 0;
+}
+
+uint8_t unifying_state_keystroke_encrypt(struct unifying_state* state, uint8_t data[UNIFYING_AES_DATA_LEN])
+{
+    uint8_t keystream[UNIFYING_AES_DATA_LEN];
+    const uint8_t* block = keystream;
+
+#if UNIFYING_KEYSTREAM_LEN
+    unifying_state_keystream_sync(state);
+
+    if(state->keystream_count)
+    {
+        block = state->keystream[state->keystream_front];
+    }
+    else
+#endif
+    {
+        uint8_t status = unifying_state_keystream_compute(state, keystream, state->aes_counter);
+
+        if(status)
+        {
+            return status;
+        }
+    }
+
+    for(uint8_t i = 0; i < UNIFYING_AES_DATA_LEN; i++)
+    {
+        data[i] ^= block[i];
+    }
+
+    return 0;
 }
 
-struct unifying_receive_entry* unifying_receive_entry_create(uint8_t length)
+/*!
+ * Encrypt a batch of keystroke data with a shared \ref unifying_interface.encrypt_prepared_batch implementation.
+ * 
+ * \param[in]       encrypt_prepared_batch  Batch encryption function shared by every state in the batch.
+ * \param[in,out]   states                  \p count pointers to Unifying state information.
+ * \param[in,out]   data                    \p count pointers to keystroke data to encrypt in place.
+ * \param[in]       count                   Number of states. At most \ref UNIFYING_ENCRYPT_BATCH_LEN.
+ * 
+ * \return  The return value of \p encrypt_prepared_batch.
+ */
+static uint8_t unifying_state_keystroke_encrypt_flush(uint8_t (*encrypt_prepared_batch)(
+                                                          uint8_t data[][UNIFYING_AES_DATA_LEN],
+                                                          struct unifying_aes_context* const contexts[],
+                                                          const uint8_t iv[][UNIFYING_AES_BLOCK_LEN],
+                                                          uint8_t count),
+                                                      struct unifying_state* const states[],
+                                                      uint8_t* const data[],
+                                                      uint8_t count)
 {
-    struct unifying_receive_entry* entry = malloc(sizeof(struct unifying_receive_entry));
+    struct unifying_aes_context* contexts[UNIFYING_ENCRYPT_BATCH_LEN] = {0};
+    uint8_t aes_iv[UNIFYING_ENCRYPT_BATCH_LEN][UNIFYING_AES_BLOCK_LEN];
+    uint8_t aes_buffer[UNIFYING_ENCRYPT_BATCH_LEN][UNIFYING_AES_DATA_LEN];
+    struct unifying_encrypted_keystroke_iv iv;
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+        contexts[i] = &states[i]->aes_context;
+        unifying_encrypted_keystroke_iv_init(&iv, states[i]->aes_counter);
+        unifying_encrypted_keystroke_iv_pack(aes_iv[i], &iv);
+        memcpy(aes_buffer[i], data[i], UNIFYING_AES_DATA_LEN);
+    }
+
+    uint8_t status = encrypt_prepared_batch(aes_buffer, contexts, (const uint8_t (*)[UNIFYING_AES_BLOCK_LEN]) aes_iv, count);
+
+    if(status)
+    {
+        return status;
+    }
 
-    if(!entry)
+    for(uint8_t i = 0; i < count; i++)
     {
-        return NULL;
+        memcpy(data[i], aes_buffer[i], UNIFYING_AES_DATA_LEN);
     }
 
-    uint8_t* payload = malloc(length);
+    return 0;
+}
+
+uint8_t unifying_state_keystroke_encrypt_batch(struct unifying_state* const states[],
+                                               uint8_t data[][UNIFYING_AES_DATA_LEN],
+                                               size_t count)
+{
+    struct unifying_state* pending_states[UNIFYING_ENCRYPT_BATCH_LEN];
+    uint8_t* pending_data[UNIFYING_ENCRYPT_BATCH_LEN];
+    uint8_t pending_count = 0;
+    uint8_t (*pending_batch)(uint8_t data[][UNIFYING_AES_DATA_LEN],
+                             struct unifying_aes_context* const contexts[],
+                             const uint8_t iv[][UNIFYING_AES_BLOCK_LEN],
+                             uint8_t count) = NULL;
+    uint8_t result = 0;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        struct unifying_state* state = states[i];
+        const struct unifying_interface* interface = state->interface;
+        bool batchable = interface->prepare_key && interface->encrypt_prepared && interface->encrypt_prepared_batch;
+
+#if UNIFYING_KEYSTREAM_LEN
+        unifying_state_keystream_sync(state);
+
+        if(state->keystream_count)
+        {
+            // Precomputed keystream is cheaper than any batch.
+            batchable = false;
+        }
+#endif
+
+        if(batchable && unifying_state_aes_context_prepare(state))
+        {
+            result = 1;
+            continue;
+        }
+
+        if(!batchable)
+        {
+            result |= unifying_state_keystroke_encrypt(state, data[i]);
+            continue;
+        }
+
+        if(pending_count && (pending_batch != interface->encrypt_prepared_batch ||
+                             pending_count >= UNIFYING_ENCRYPT_BATCH_LEN))
+        {
+            result |= unifying_state_keystroke_encrypt_flush(pending_batch, pending_states, pending_data, pending_count);
+            pending_count = 0;
+        }
+
+        pending_batch = interface->encrypt_prepared_batch;
+        pending_states[pending_count] = state;
+        pending_data[pending_count] = data[i];
+        pending_count += 1;
+    }
 
-    if(!payload)
+    if(pending_count)
     {
-        free(entry);
-        return NULL;
+        result |= unifying_state_keystroke_encrypt_flush(pending_batch, pending_states, pending_data, pending_count);
     }
 
-    unifying_receive_entry_init(entry, payload, length);
-    return entry;
+    return result;
 }
 
-void unifying_receive_entry_destroy(struct unifying_receive_entry* entry)
+void unifying_transmit_entry_init(struct unifying_transmit_entry* entry,
+                                  uint8_t length,
+                                  uint16_t timeout)
+{
+    entry->length = length;
+    entry->timeout = timeout;
+}
+
+void unifying_receive_entry_init(struct unifying_receive_entry* entry, uint8_t length)
 {
-    free(entry->payload);
-    free(entry);
+    entry->length = length;
 }
@@ -35,6 +35,204 @@
 #include "aes.h"
 #endif
 
+#ifndef UNIFYING_AES_NI
+#if defined(UNIFYING_HARDWARE_AES) && (UNIFYING_HARDWARE_AES == 0) && \
+    defined(__x86_64__) && defined(__linux__) && defined(__GNUC__)
+/*!
+ * Compile an AES-NI implementation of the default AES encryption.
+ * 
+ * This defaults to `1` when building the software AES implementation for x86-64 Linux with a GCC compatible compiler.
+ * The AES-NI implementation is only used if the CPU reports support for it at runtime.
+ * Otherwise the software implementation is used.
+ * Defining this as `0` will disable the AES-NI implementation.
+ */
+#define UNIFYING_AES_NI 1
+#else
+#define UNIFYING_AES_NI 0
+#endif
+#endif
+
+#ifndef UNIFYING_KEYSTREAM_LEN
+/*!
+ * Number of encrypted keystroke keystream blocks that \ref unifying_state can precompute.
+ * 
+ * Keystream for upcoming AES counter values is computed while waiting to transmit
+ * so that encrypting a keystroke does not require running AES.
+ * Each block occupies \ref UNIFYING_AES_DATA_LEN bytes.
+ * Defining this as `0` disables keystream precomputation.
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_KEYSTREAM_LEN 4
+#endif
+
+#ifndef UNIFYING_CONTROL_BUFFER_LEN
+/*!
+ * Number of control payloads that \ref unifying_state.control_buffer can hold.
+ * 
+ * Must be a power of two. See unifying_ring_buffer_init().
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_CONTROL_BUFFER_LEN 4
+#endif
+
+#ifndef UNIFYING_ENCRYPT_BATCH_LEN
+/*!
+ * Maximum number of blocks passed to \ref unifying_interface.encrypt_prepared_batch at once.
+ * 
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_ENCRYPT_BATCH_LEN 8
+#endif
+
+#ifndef UNIFYING_AES_CONTEXT_LEN
+/*!
+ * Size in bytes of a \ref unifying_aes_context when \ref UNIFYING_HARDWARE_AES is not `0`.
+ * 
+ * This can be re-defined by this library's user to fit whatever
+ * their \ref unifying_interface.prepare_key "prepare_key" implementation needs to store.
+ */
+#define UNIFYING_AES_CONTEXT_LEN 176
+#endif
+
+#ifndef UNIFYING_HIDPP_1_0_REGISTER_SLOTS
+/*!
+ * Number of slots in the table used to look up HID++ 1.0 registers by address.
+ * 
+ * Must be a power of two. At most one less than this many registers can be set.
+ * See unifying_state_hidpp_registers_set().
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_HIDPP_1_0_REGISTER_SLOTS 16
+#endif
+
+#ifndef UNIFYING_HIDPP_2_0_FEATURES_LEN
+/*!
+ * Maximum number of HID++ 2.0 features, including the ones that unifying_state_init() adds.
+ * 
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_HIDPP_2_0_FEATURES_LEN 8
+#endif
+
+#ifndef UNIFYING_HIDPP_2_0_DEVICE_TYPE
+/*!
+ * Device type reported by the HID++ 2.0 `DEVICE_NAME_TYPE` feature.
+ * 
+ * `0` is a keyboard and `3` is a mouse.
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_HIDPP_2_0_DEVICE_TYPE 0
+#endif
+
+#ifndef UNIFYING_HIDPP_RETRY_INTERVAL
+/*!
+ * Milliseconds to wait before retrying a HID++ response that failed to transmit.
+ * 
+ * The wait doubles with each failure in a row, up to 16 times this value.
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_HIDPP_RETRY_INTERVAL 2
+#endif
+
+#ifndef UNIFYING_PAIR_RESPONSE_TIMEOUT
+/*!
+ * Milliseconds to wait for each pairing response before pairing fails with \ref UNIFYING_TIMEOUT_ERROR.
+ * 
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_PAIR_RESPONSE_TIMEOUT 2000
+#endif
+
+#ifndef UNIFYING_PAIR_CHANNEL_DWELL
+/*!
+ * Milliseconds to keep retrying the initial pairing request on one pairing channel before moving to the next.
+ * 
+ * \see unifying_pairing_channels
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_PAIR_CHANNEL_DWELL 4
+#endif
+
+#ifndef UNIFYING_PAIR_SWEEPS
+/*!
+ * Number of times every pairing channel is tried before pairing fails with \ref UNIFYING_TRANSMIT_ERROR.
+ * 
+ * \see unifying_pairing_channels
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_PAIR_SWEEPS 3
+#endif
+
+#ifndef UNIFYING_COUNTER_LEASE_LEN
+/*!
+ * Number of AES counter values reserved by each counter lease.
+ * 
+ * A lease slot is written to non-volatile memory once per this many encrypted keystrokes.
+ * Up to this many counter values are skipped each time the device starts.
+ * 
+ * \see unifying_state_counter_lease_renew()
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_COUNTER_LEASE_LEN 1024
+#endif
+
+#ifndef UNIFYING_COUNTER_LEASE_SLOTS
+/*!
+ * Number of non-volatile memory slots that counter leases are written to in turn.
+ * 
+ * Each slot is written once per \ref UNIFYING_COUNTER_LEASE_SLOTS leases, spreading wear across them.
+ * This can be re-defined by this library's user.
+ */
+#define UNIFYING_COUNTER_LEASE_SLOTS 8
+#endif
+
+/*!
+ * Length of one counter lease slot in bytes.
+ * 
+ * A slot holds the counter value that the lease ends at followed by a checksum.
+ */
+#define UNIFYING_COUNTER_LEASE_SLOT_LEN 5
+
+/*!
+ * Version of the layout written by unifying_state_blob_pack().
+ * 
+ * This changes whenever the layout changes so that blobs written by older versions of this library are rejected.
+ */
+#define UNIFYING_STATE_BLOB_VERSION 1
+
+/*!
+ * Length of the blob written by unifying_state_blob_pack() in bytes.
+ * 
+ * This is a version byte, the RF address, the AES key, a \ref unifying_link_snapshot, and a checksum.
+ */
+#define UNIFYING_STATE_BLOB_LEN (1 + UNIFYING_ADDRESS_LEN + UNIFYING_AES_BLOCK_LEN + 3 + UNIFYING_CHANNELS_LEN + 1)
+
+/*!
+ * Link quality given to a channel that hasn't been transmitted on.
+ * 
+ * \see unifying_channel_stats.quality
+ */
+#define UNIFYING_CHANNEL_QUALITY_UNKNOWN 0x80
+
+/*!
+ * AES-128 encryption context prepared from an encryption key.
+ * 
+ * This typically holds an expanded key schedule so that the key doesn't need to be expanded for every encryption.
+ * 
+ * \see unifying_interface.prepare_key
+ * \see unifying_interface.encrypt_prepared
+ */
+struct unifying_aes_context
+{
+#if defined(UNIFYING_HARDWARE_AES) && (UNIFYING_HARDWARE_AES == 0)
+    /// Tiny AES context containing the expanded key schedule.
+    struct AES_ctx aes;
+#else
+    /// Implementation defined context data.
+    uint8_t data[UNIFYING_AES_CONTEXT_LEN];
+#endif
+};
+
 /*!
  * Functions for interfacing with hardware.
  * 
@@ -96,11 +294,14 @@ struct unifying_interface
      */
     uint8_t (*set_channel)(uint8_t channel);
     /*!
-     * Return the time in milliseconds since execution started.
+     * Return the time since execution started.
+     * 
+     * The time is allowed to wrap around past `UINT32_MAX`.
      * 
      * \todo    Use millis() by default if we are running on Arduino.
      * 
-     * \return  Time in milliseconds since execution started.
+     * \return  Time in milliseconds since execution started,
+     *          or in 1/\ref UNIFYING_TIME_TICKS_PER_MS millisecond units if that has been re-defined.
      */
     uint32_t (*time)();
     /*!
@@ -123,6 +324,301 @@ struct unifying_interface
     uint8_t (*encrypt)(uint8_t data[UNIFYING_AES_DATA_LEN],
                        const uint8_t key[UNIFYING_AES_BLOCK_LEN],
                        const uint8_t iv[UNIFYING_AES_BLOCK_LEN]);
+    /*!
+     * Prepare an AES-128 context from an encryption key.
+     * 
+     * This is optional. If this and \ref unifying_interface.encrypt_prepared "encrypt_prepared" are set
+     * then they will be used instead of \ref unifying_interface.encrypt "encrypt".
+     * The prepared context is cached in \ref unifying_state.aes_context "state.aes_context"
+     * and only prepared again when the encryption key changes.
+     * 
+     * \param[out]  context     Context to prepare.
+     * \param[in]   key         AES-128 encryption key.
+     * 
+     * \return  `0` if successful.
+     * \return  Anything else on failure.
+     */
+    uint8_t (*prepare_key)(struct unifying_aes_context* context,
+                           const uint8_t key[UNIFYING_AES_BLOCK_LEN]);
+    /*!
+     * AES-128 encrypt the supplied data with a prepared context.
+     * 
+     * \param[in,out]   data        \ref UNIFYING_AES_DATA_LEN bytes of unencrypted data are supplied.
+     *                              If encryption is successful then at least \ref UNIFYING_AES_DATA_LEN bytes
+     *                              of encrypted data should be returned.
+     * \param[in,out]   context     Context previously prepared by
+     *                              \ref unifying_interface.prepare_key "prepare_key".
+     * \param[in]       iv          AES-128 initialization vector.
+     * 
+     * \return  `0` if successful.
+     * \return  Anything else on failure.
+     */
+    uint8_t (*encrypt_prepared)(uint8_t data[UNIFYING_AES_DATA_LEN],
+                                struct unifying_aes_context* context,
+                                const uint8_t iv[UNIFYING_AES_BLOCK_LEN]);
+    /*!
+     * AES-128 encrypt several independent blocks of data, each with its own prepared context.
+     * 
+     * This is optional. It allows implementations to keep several blocks in flight at once
+     * when many devices are encrypting keystrokes together.
+     * See unifying_state_keystroke_encrypt_batch().
+     * 
+     * \param[in,out]   data        \p count buffers of \ref UNIFYING_AES_DATA_LEN bytes to encrypt in place.
+     * \param[in,out]   contexts    \p count contexts previously prepared by
+     *                              \ref unifying_interface.prepare_key "prepare_key".
+     * \param[in]       iv          \p count AES-128 initialization vectors.
+     * \param[in]       count       Number of blocks. This is never larger than \ref UNIFYING_ENCRYPT_BATCH_LEN.
+     * 
+     * \return  `0` if successful.
+     * \return  Anything else on failure.
+     */
+    uint8_t (*encrypt_prepared_batch)(uint8_t data[][UNIFYING_AES_DATA_LEN],
+                                      struct unifying_aes_context* const contexts[],
+                                      const uint8_t iv[][UNIFYING_AES_BLOCK_LEN],
+                                      uint8_t count);
+    /*!
+     * Block until \ref unifying_interface.time "time" reaches a deadline.
+     * 
+     * This is optional. If it is set then unifying_loop() sleeps through the time between transmissions
+     * instead of repeatedly calling unifying_tick().
+     * Implementations may return early, for example when the radio signals an RX event
+     * or when a payload is queued from another context.
+     * Returning early is always safe.
+     * 
+     * \param[in]   deadline    Time, as returned by \ref unifying_interface.time "time",
+     *                          at which this function should return.
+     *                          The deadline may have wrapped around past `UINT32_MAX`.
+     */
+    void (*wait_until)(uint32_t deadline);
+};
+
+/*!
+ * Information stored in \ref unifying_state.transmit_buffer "state.transmit_buffer"
+ */
+struct unifying_transmit_entry
+{
+    /// Array of bytes to transmit.
+    uint8_t payload[UNIFYING_MAX_PAYLOAD_LEN];
+    /// Number of bytes in `payload` to transmit.
+    uint8_t length;
+    /// New timeout value to set if `payload` is successfully transmitted.
+    uint16_t timeout;
+};
+
+/*!
+ * A step of the idle timeout ladder.
+ * 
+ * Once no input has been transmitted for `idle_time`, the keep-alive timeout is raised to `timeout`.
+ * 
+ * \see unifying_state_idle_ladder_set()
+ */
+struct unifying_idle_step
+{
+    /// Milliseconds without input before this step is taken.
+    uint32_t idle_time;
+    /// Keep-alive timeout to set when this step is taken.
+    uint16_t timeout;
+};
+
+/*!
+ * Number of steps in \ref unifying_default_idle_ladder.
+ */
+#define UNIFYING_DEFAULT_IDLE_LADDER_LEN 2
+
+/*!
+ * Idle timeout ladder used by unifying_state_init().
+ * 
+ * The timeout is raised to 110ms after half a second without input, matching what Logitech keyboards do
+ * after a key is released, and to 1200ms after 10 seconds without input.
+ */
+extern const struct unifying_idle_step unifying_default_idle_ladder[UNIFYING_DEFAULT_IDLE_LADDER_LEN];
+
+/*!
+ * Steps of the pairing process.
+ * 
+ * Each request is queued in \ref unifying_state.control_buffer "state.control_buffer".
+ * Once it has been transmitted, keep-alive payloads are transmitted until the receiver responds.
+ * 
+ * \see unifying_pair_start()
+ */
+enum unifying_pair_step
+{
+    /// Not pairing.
+    UNIFYING_PAIR_STEP_IDLE = 0,
+    /// Waiting for pairing request 1 to be transmitted.
+    UNIFYING_PAIR_STEP_REQUEST_1,
+    /// Waiting for pairing response 1.
+    UNIFYING_PAIR_STEP_RESPONSE_1,
+    /// Waiting for pairing request 2 to be transmitted.
+    UNIFYING_PAIR_STEP_REQUEST_2,
+    /// Waiting for pairing response 2.
+    UNIFYING_PAIR_STEP_RESPONSE_2,
+    /// Waiting for pairing request 3 to be transmitted.
+    UNIFYING_PAIR_STEP_REQUEST_3,
+    /// Waiting for pairing response 3.
+    UNIFYING_PAIR_STEP_RESPONSE_3,
+    /// Waiting for the pairing complete request to be transmitted.
+    UNIFYING_PAIR_STEP_COMPLETE,
+};
+
+/*!
+ * Information kept between the steps of the pairing process.
+ * 
+ * \see unifying_pair_start()
+ */
+struct unifying_pairing
+{
+    /// Current step.
+    enum unifying_pair_step step;
+    /// Result of the last pairing process, or \ref UNIFYING_BUSY_ERROR while pairing.
+    enum unifying_error result;
+    /// Random value used for verifying the early stage of the pairing process.
+    uint8_t id;
+    /// Product ID of this device.
+    uint16_t product_id;
+    /// Random number for AES encryption key generation.
+    uint32_t crypto;
+    /// Serial number of this device.
+    uint32_t serial;
+    /// HID++ capabilities.
+    uint16_t capabilities;
+    /// Name of this device, sent in pairing request 3.
+    char name[UNIFYING_MAX_NAME_LEN];
+    /// Length of \ref name.
+    uint8_t name_length;
+    /// Product ID of the receiver, from pairing response 1.
+    uint16_t receiver_product_id;
+    /// Random number for AES encryption key generation, from pairing response 2.
+    uint32_t receiver_crypto;
+    /*!
+     * Indices into \ref unifying_pairing_channels in the order they are tried.
+     * 
+     * The channel that pairing request 1 was last transmitted on is moved to the front,
+     * so pairing with the same receiver again finds it on the first try.
+     */
+    uint8_t channel_order[UNIFYING_PAIRING_CHANNELS_LEN];
+    /// Number of pairing channels that pairing request 1 has been tried on, counting repeats.
+    uint16_t sweep_position;
+    /// Time that pairing request 1 was first tried on the current pairing channel.
+    uint32_t dwell_start;
+    /// Time at which waiting for the current response fails.
+    uint32_t deadline;
+};
+
+/*!
+ * HID++ 1.0 register that unifying_tick() answers queries for.
+ * 
+ * \see unifying_state_hidpp_registers_set()
+ */
+struct unifying_hidpp_1_0_register
+{
+    /// Register address.
+    uint8_t address;
+    /// `true` if this is a long register, `false` if this is a short register.
+    bool long_register;
+    /// `true` if the register can be set, `false` if it is read-only.
+    bool writable;
+    /*!
+     * Register value.
+     * 
+     * Short registers hold \ref UNIFYING_HIDPP_1_0_SHORT_REGISTER_LEN bytes and
+     * long registers hold \ref UNIFYING_HIDPP_1_0_LONG_REGISTER_LEN bytes.
+     * Setting a writable register writes to this buffer.
+     */
+    uint8_t* value;
+};
+
+/*!
+ * HID++ 2.0 feature that unifying_tick() answers queries for.
+ * 
+ * \see unifying_state_hidpp_feature_add()
+ */
+struct unifying_hidpp_2_0_feature
+{
+    /// Feature ID, such as \ref UNIFYING_HIDPP_2_0_FEATURE_DEVICE_NAME_TYPE.
+    uint16_t id;
+    /// Feature type bitfield.
+    uint8_t type;
+    /// Feature version.
+    uint8_t version;
+    /*!
+     * Precomputed response parameters for each function, indexed by function ID.
+     * 
+     * Every call to a function is answered with the same parameters, whatever the request's parameters are.
+     * This is not used for the `ROOT` and `FEATURE_SET` features, which are answered from the feature table.
+     */
+    const uint8_t (*responses)[UNIFYING_HIDPP_2_0_RESPONSE_LEN];
+    /// Number of functions in `responses`.
+    uint8_t functions_len;
+};
+
+/*!
+ * Mouse input that unifying_mouse() has accepted but not yet queued for transmission.
+ */
+struct unifying_mouse_carry
+{
+    /// Bitfield of the mouse buttons held during the movement.
+    uint8_t buttons;
+    /// Indicates that a mouse payload still has to be queued, even if all movement is zero.
+    bool pending;
+    /// Y axis mouse movement.
+    int32_t move_y;
+    /// X axis mouse movement.
+    int32_t move_x;
+    /// Y axis scroll wheel movement.
+    int32_t wheel_y;
+    /// X axis scroll wheel movement.
+    int32_t wheel_x;
+};
+
+/*!
+ * Information stored in \ref unifying_state.receive_buffer "state.receive_buffer"
+ */
+struct unifying_receive_entry
+{
+    /// Array of received bytes.
+    uint8_t payload[UNIFYING_MAX_PAYLOAD_LEN];
+    /// Number of bytes received into `payload`.
+    uint8_t length;
+};
+
+/*!
+ * Transmission statistics for one RF channel.
+ * 
+ * \see unifying_state_channel_record()
+ * \see unifying_state_channel_next()
+ */
+struct unifying_channel_stats
+{
+    /// Number of successful transmissions. Stops counting at `UINT16_MAX`.
+    uint16_t successes;
+    /// Number of failed transmissions. Stops counting at `UINT16_MAX`.
+    uint16_t failures;
+    /*!
+     * Recent link quality from `0` to `0xFF`.
+     * 
+     * Each success moves it a quarter of the way up to `0xFF` and each failure moves it an eighth of the way down
+     * to `0`, so recent transmissions count the most. Failures count for less because a good channel also fails
+     * while the receiver is listening on another one.
+     * Starts at \ref UNIFYING_CHANNEL_QUALITY_UNKNOWN.
+     */
+    uint8_t quality;
+};
+
+/*!
+ * Link information that can be saved before sleeping or powering off, and restored to reconnect quickly.
+ * 
+ * \see unifying_state_link_snapshot()
+ * \see unifying_state_link_restore()
+ */
+struct unifying_link_snapshot
+{
+    /// Channel that the receiver was last reached on.
+    uint8_t channel;
+    /// Keep-alive timeout that the receiver last set.
+    uint16_t timeout;
+    /// \ref unifying_channel_stats.quality "Quality" of each channel in \ref unifying_channels.
+    uint8_t channel_quality[UNIFYING_CHANNELS_LEN];
 };
 
 /*!
@@ -132,8 +628,29 @@ struct unifying_state
 {
     /// Functions for interfacing with hardware.
     const struct unifying_interface* interface;
-    /// Buffer for payloads to be transmitted.
+    /*!
+     * Buffer for input payloads to be transmitted.
+     * 
+     * unifying_tick() is the only consumer of this buffer and always serves it first.
+     * Payloads may be produced from a single other context while unifying_tick() runs.
+     */
     struct unifying_ring_buffer* transmit_buffer;
+    /*!
+     * Buffer for control payloads to be transmitted, such as pairing and set timeout requests.
+     * 
+     * unifying_tick() only serves this buffer once there are no input payloads or HID++ queries to handle.
+     * Payloads must be produced from the same context that calls unifying_tick().
+     */
+    struct unifying_ring_buffer control_buffer;
+    /// Storage for `control_buffer`.
+    struct unifying_transmit_entry control_entries[UNIFYING_CONTROL_BUFFER_LEN];
+    /*!
+     * Mouse input that didn't fit in `transmit_buffer`.
+     * 
+     * Only unifying_mouse() uses this, from the context that produces `transmit_buffer` payloads.
+     * unifying_mouse_pending() reports whether anything is left here.
+     */
+    struct unifying_mouse_carry mouse_carry;
     /// Buffer for received payloads to be handled.
     struct unifying_ring_buffer* receive_buffer;
     /// RF address.
@@ -142,6 +659,31 @@ struct unifying_state
     uint8_t *aes_key;
     /// AES counter.
     uint32_t aes_counter;
+    /*!
+     * AES counter value that the current counter lease ends at.
+     * 
+     * Only meaningful if `aes_counter_leased` is `true`.
+     * Encrypted keystrokes fail with \ref UNIFYING_COUNTER_LEASE_ERROR once `aes_counter` reaches this.
+     */
+    uint32_t aes_counter_lease;
+    /// Counter lease slot that was written last.
+    uint8_t aes_counter_lease_slot;
+    /// Indicates that `aes_counter` is limited by a counter lease.
+    bool aes_counter_leased;
+    /// AES context prepared from `aes_key`. Only meaningful if `aes_context_valid` is `true`.
+    struct unifying_aes_context aes_context;
+    /// Indicates that `aes_context` was prepared from the current `aes_key`.
+    bool aes_context_valid;
+#if UNIFYING_KEYSTREAM_LEN
+    /// Ring buffer of precomputed keystream blocks for consecutive AES counter values.
+    uint8_t keystream[UNIFYING_KEYSTREAM_LEN][UNIFYING_AES_DATA_LEN];
+    /// AES counter that the keystream block at `keystream_front` belongs to.
+    uint32_t keystream_counter;
+    /// Index of the first keystream block.
+    uint8_t keystream_front;
+    /// Number of precomputed keystream blocks.
+    uint8_t keystream_count;
+#endif
     /*!
      * Default timeout.
      * Transmitting some payloads will set `timeout` to this value.
@@ -149,36 +691,54 @@ struct unifying_state
     uint16_t default_timeout;
     /// Current timeout for keep-alive packets.
     uint16_t timeout;
+    /// Steps for raising `timeout` while no input is transmitted. May be `NULL`.
+    const struct unifying_idle_step* idle_ladder;
+    /// Number of steps in `idle_ladder`.
+    uint8_t idle_ladder_len;
+    /// Number of steps in `idle_ladder` that have been taken since the last input.
+    uint8_t idle_step;
+    /// Time that an input payload was last transmitted.
+    uint32_t last_activity;
     /// Time that the previous payload was transmitted.
     uint32_t previous_transmit;
     /// Time that the next payload should be transmitted, based on the current timeout.
+    /// \see unifying_timeout_interval()
     uint32_t next_transmit;
+    /// HID++ 1.0 registers that queries are answered from. May be `NULL`.
+    const struct unifying_hidpp_1_0_register* hidpp_registers;
+    /*!
+     * Hash table for finding registers in `hidpp_registers` by address.
+     * 
+     * Each slot holds one more than the position of a register, or `0` if the slot is empty.
+     */
+    uint8_t hidpp_register_slots[UNIFYING_HIDPP_1_0_REGISTER_SLOTS];
+    /// HID++ 2.0 features. Each feature's position is its feature index.
+    struct unifying_hidpp_2_0_feature hidpp_features[UNIFYING_HIDPP_2_0_FEATURES_LEN];
+    /// Number of features in `hidpp_features`.
+    uint8_t hidpp_features_len;
+    /*!
+     * Precomputed responses for the `DEVICE_NAME_TYPE` feature's
+     * `getDeviceNameCount`, `getDeviceName`, and `getDeviceType` functions.
+     * 
+     * \see unifying_state_name_set()
+     */
+    uint8_t hidpp_name_responses[3][UNIFYING_HIDPP_2_0_RESPONSE_LEN];
+    /// Number of times in a row that the response to the HID++ query at the front of `receive_buffer` failed.
+    uint8_t hidpp_failures;
+    /// Time that a failed HID++ response is retried at. Only meaningful if `hidpp_failures` isn't `0`.
+    uint32_t hidpp_retry;
+    /// Keyboard scancodes in the last encrypted keystroke that the receiver acknowledged.
+    uint8_t keyboard_keys[UNIFYING_KEYS_LEN];
+    /// Modifier bitfield in the last encrypted keystroke that the receiver acknowledged.
+    uint8_t keyboard_modifiers;
+    /// Pairing process advanced by unifying_tick().
+    struct unifying_pairing pairing;
     /// Current RF channel. This is used to compute a new channel in the event of a transmission failure.
     uint8_t channel;
-};
-
-/*!
- * Information stored in \ref unifying_state.transmit_buffer "state.transmit_buffer"
- */
-struct unifying_transmit_entry
-{
-    /// Array of bytes to transmit.
-    uint8_t* payload;
-    /// Size of `payload` in bytes.
-    uint8_t length;
-    /// New timeout value to set if `payload` is successfully transmitted.
-    uint8_t timeout;
-};
-
-/*!
- * Information stored in \ref unifying_state.receive_buffer "state.receive_buffer"
- */
-struct unifying_receive_entry
-{
-    /// Array of received bytes.
-    uint8_t* payload;
-    /// Size of `payload` in bytes.
-    uint8_t length;
+    /// Transmission statistics for each channel in \ref unifying_channels.
+    struct unifying_channel_stats channel_stats[UNIFYING_CHANNELS_LEN];
+    /// Bitfield of channels in \ref unifying_channels that failed since the last successful transmission.
+    uint32_t channels_tried;
 };
 
 #ifdef __cplusplus
@@ -201,14 +761,21 @@ extern "C" {
  *                                  see \ref unifying_interface.set_address for more details.
  * \param[in]   set_channel         Function for setting the RF channel of a radio.
  *                                  see \ref unifying_interface.set_channel for more details.
- * \param[in]   time                Function getting the time since execution started in milliseconds.
+ * \param[in]   time                Function getting the time since execution started.
  *                                  see \ref unifying_interface.time for more details.
  * \param[in]   encrypt             Function for AES-128 encrypting data.
  *                                  If \ref UNIFYING_HARDWARE_AES is `0` (default) then 
  *                                  a default implementation is provided for this function.
+ *                                  If \ref UNIFYING_AES_NI is `1` and the CPU supports AES-NI then
+ *                                  the default implementation uses AES-NI instructions.
  *                                  Specify `NULL` to use the default implementation.
  *                                  see \ref unifying_interface.encrypt for more details.
  * 
+ * \note    If the default implementation of \p encrypt is used then default implementations of
+ *          \ref unifying_interface.prepare_key, \ref unifying_interface.encrypt_prepared,
+ *          and \ref unifying_interface.encrypt_prepared_batch are used as well.
+ *          Otherwise they are set to `NULL`. See unifying_interface_encrypt_prepared_set().
+ * 
  * \return  \ref UNIFYING_ERROR if \p encrypt is `NULL` and no default implementation is available.
  * \return  \ref UNIFYING_SUCCESS otherwise.
  * 
@@ -226,16 +793,58 @@ enum unifying_error unifying_interface_init(struct unifying_interface* interface
                                                                const uint8_t key[UNIFYING_AES_BLOCK_LEN],
                                                                const uint8_t iv[UNIFYING_AES_BLOCK_LEN]));
 
+/*!
+ * Set the functions used for encrypting with a prepared AES context.
+ * 
+ * \param[in,out]  interface               An initialized \ref unifying_interface.
+ * \param[in]      prepare_key             Function for preparing an AES context from a key.
+ *                                          see \ref unifying_interface.prepare_key for more details.
+ * \param[in]      encrypt_prepared        Function for AES-128 encrypting data with a prepared context.
+ *                                          see \ref unifying_interface.encrypt_prepared for more details.
+ * \param[in]      encrypt_prepared_batch  Function for AES-128 encrypting several blocks with prepared contexts.
+ *                                          This may be `NULL`.
+ *                                          see \ref unifying_interface.encrypt_prepared_batch for more details.
+ * 
+ * \see unifying_interface
+ */
+void unifying_interface_encrypt_prepared_set(struct unifying_interface* interface,
+                                             uint8_t (*prepare_key)(struct unifying_aes_context* context,
+                                                                    const uint8_t key[UNIFYING_AES_BLOCK_LEN]),
+                                             uint8_t (*encrypt_prepared)(uint8_t data[UNIFYING_AES_DATA_LEN],
+                                                                         struct unifying_aes_context* context,
+                                                                         const uint8_t iv[UNIFYING_AES_BLOCK_LEN]),
+                                             uint8_t (*encrypt_prepared_batch)(
+                                                 uint8_t data[][UNIFYING_AES_DATA_LEN],
+                                                 struct unifying_aes_context* const contexts[],
+                                                 const uint8_t iv[][UNIFYING_AES_BLOCK_LEN],
+                                                 uint8_t count));
+
+/*!
+ * Set the function used for sleeping until the next transmission is due.
+ * 
+ * \param[in,out]  interface   An initialized \ref unifying_interface.
+ * \param[in]      wait_until  Function for blocking until a deadline. This may be `NULL`.
+ *                             see \ref unifying_interface.wait_until for more details.
+ * 
+ * \see unifying_interface
+ */
+void unifying_interface_wait_until_set(struct unifying_interface* interface, void (*wait_until)(uint32_t deadline));
+
 /*!
  * Initialize a \ref unifying_state structure.
  * 
+ * Payloads are packed directly into entries stored inside \p transmit_buffer and \p receive_buffer
+ * so no dynamic memory allocation is performed after initialization.
+ * 
  * \param[out]  state               Pointer to a \ref unifying_state to initialize.
  * \param[in]   interface           Pointer to an initialized \ref unifying_interface
  *                                  for accessing hardware features.
  * \param[in]   transmit_buffer     Pointer to an initialized \ref unifying_ring_buffer 
- *                                  for buffering payloads for transmission.
+ *                                  for buffering input payloads for transmission.
+ *                                  Its entries must be \ref unifying_transmit_entry structures.
  * \param[in]   receive_buffer      Pointer to an initialized \ref unifying_ring_buffer 
  *                                  for buffering received payloads.
+ *                                  Its entries must be \ref unifying_receive_entry structures.
  * \param[in]   address             Byte array with space for at least \ref UNIFYING_ADDRESS_LEN bytes
  *                                  to store an RF address.
  * \param[in]   aes_key             Byte array with space for at least \ref UNIFYING_AES_BLOCK_LEN bytes
@@ -245,6 +854,9 @@ enum unifying_error unifying_interface_init(struct unifying_interface* interface
  * \param[in]   channel             RF channel to communicate on.
  *                                  This should be a value from \ref unifying_channels.
  * 
+ * The idle timeout ladder is set to \ref unifying_default_idle_ladder.
+ * See unifying_state_idle_ladder_set() to change it.
+ * 
  * \todo    Define valid values for `default_timeout`.
  * 
  * \see unifying_state
@@ -261,21 +873,100 @@ void unifying_state_init(struct unifying_state* state,
                          uint8_t channel);
 
 /*!
- * Remove and free all items in \ref unifying_state.transmit_buffer "state.transmit_buffer".
+ * Set the steps used for raising the keep-alive timeout while the device is idle.
+ * 
+ * Whenever a keep-alive payload is due, unifying_tick() checks how long it has been since input
+ * was last transmitted. If the next step's \ref unifying_idle_step.idle_time "idle_time" has passed then
+ * a \ref unifying_set_timeout_request "set timeout" payload is transmitted in place of the keep-alive.
+ * Transmitting any input payload restores \ref unifying_state.default_timeout "state.default_timeout"
+ * and starts the ladder over.
+ * 
+ * \param[in,out]   state       Unifying state information.
+ * \param[in]       ladder      Steps ordered by increasing \ref unifying_idle_step.idle_time "idle_time".
+ *                              This may be `NULL` to keep the timeout unchanged while idle.
+ * \param[in]       length      Number of steps in \p ladder.
+ */
+void unifying_state_idle_ladder_set(struct unifying_state* state,
+                                    const struct unifying_idle_step* ladder,
+                                    uint8_t length);
+
+/*!
+ * Set the HID++ 1.0 registers that unifying_tick() answers `GET_REGISTER`, `SET_REGISTER`,
+ * `GET_LONG_REGISTER`, and `SET_LONG_REGISTER` queries from.
+ * 
+ * Queries for any other register are answered with \ref UNIFYING_HIDPP_1_0_ERROR_INVALID_ADDRESS.
+ * No registers are set by unifying_state_init().
+ * 
+ * \param[in,out]   state       Unifying state information.
+ * \param[in]       registers   Registers with distinct addresses. This may be `NULL` to remove all registers.
+ *                              The array must stay valid for as long as it is set.
+ * \param[in]       length      Number of registers in \p registers.
+ * 
+ * \return  \ref UNIFYING_BUFFER_FULL_ERROR if \p length is not less than \ref UNIFYING_HIDPP_1_0_REGISTER_SLOTS.
+ *          The registers are left unchanged.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+enum unifying_error unifying_state_hidpp_registers_set(struct unifying_state* state,
+                                                       const struct unifying_hidpp_1_0_register* registers,
+                                                       uint8_t length);
+
+/*!
+ * Find a HID++ 1.0 register set by unifying_state_hidpp_registers_set().
+ * 
+ * \param[in]   state       Unifying state information.
+ * \param[in]   address     Register address.
+ * 
+ * \return  Pointer to the register at \p address, or `NULL` if there is no such register.
+ */
+const struct unifying_hidpp_1_0_register* unifying_state_hidpp_register(const struct unifying_state* state,
+                                                                        uint8_t address);
+
+/*!
+ * Add a HID++ 2.0 feature for unifying_tick() to answer queries for.
+ * 
+ * unifying_state_init() adds the `ROOT`, `FEATURE_SET`, and `DEVICE_NAME_TYPE` features.
+ * Features are given feature indices in the order that they are added.
+ * 
+ * \param[in,out]   state       Unifying state information.
+ * \param[in]       feature     Feature to add. It is copied, but its \ref unifying_hidpp_2_0_feature.responses
+ *                              "responses" must stay valid for as long as \p state is used.
+ * 
+ * \return  \ref UNIFYING_BUFFER_FULL_ERROR if \ref UNIFYING_HIDPP_2_0_FEATURES_LEN features were already added.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+enum unifying_error unifying_state_hidpp_feature_add(struct unifying_state* state,
+                                                     const struct unifying_hidpp_2_0_feature* feature);
+
+/*!
+ * Set the device name reported by the HID++ 2.0 `DEVICE_NAME_TYPE` feature.
+ * 
+ * unifying_pair() sets this to the name that it pairs with.
+ * Call this after restoring a previous pairing so that the name is reported correctly.
+ * 
+ * \param[in,out]   state       Unifying state information.
+ * \param[in]       name        Name of the device. This does not need to be NULL terminated.
+ * \param[in]       length      Length of \p name. Names longer than \ref UNIFYING_MAX_NAME_LEN are truncated.
+ */
+void unifying_state_name_set(struct unifying_state* state, const char* name, uint8_t length);
+
+/*!
+ * Remove all items in \ref unifying_state.transmit_buffer "state.transmit_buffer"
+ * and \ref unifying_state.control_buffer "state.control_buffer".
  * 
  * \param[in,out]   state   Unifying state information.
  */
 void unifying_state_transmit_buffer_clear(struct unifying_state* state);
 
 /*!
- * Remove and free all items in \ref unifying_state.receive_buffer "state.receive_buffer".
+ * Remove all items in \ref unifying_state.receive_buffer "state.receive_buffer".
  * 
  * \param[in,out]   state   Unifying state information.
  */
 void unifying_state_receive_buffer_clear(struct unifying_state* state);
 
 /*!
- * Remove and free all items in \ref unifying_state.transmit_buffer "state.transmit_buffer" 
+ * Remove all items in \ref unifying_state.transmit_buffer "state.transmit_buffer",
+ * \ref unifying_state.control_buffer "state.control_buffer",
  * and \ref unifying_state.receive_buffer "state.receive_buffer".
  * 
  * \param[in,out]   state   Unifying state information.
@@ -295,6 +986,143 @@ void unifying_state_buffers_clear(struct unifying_state* state);
  */
 uint8_t unifying_state_channel_set(struct unifying_state* state, uint8_t channel);
 
+/*!
+ * Record the result of a transmission on the current RF channel.
+ * 
+ * Nothing is recorded if \ref unifying_state.channel "state.channel" isn't in \ref unifying_channels.
+ * 
+ * \param[in,out]   state       Unifying state information.
+ * \param[in]       success     `true` if the transmission was acknowledged.
+ */
+void unifying_state_channel_record(struct unifying_state* state, bool success);
+
+/*!
+ * Choose the RF channel to move to after a transmission fails.
+ * 
+ * Picks the channel with the best \ref unifying_channel_stats.quality "quality" that hasn't failed since
+ * the last successful transmission. Channels that recently worked are tried before untried ones,
+ * and channels that keep failing are tried last.
+ * Ties go to the channel that comes first after the current one in \ref unifying_channels,
+ * so without any statistics this steps through every channel in turn like unifying_next_channel().
+ * 
+ * \param[in]   state   Unifying state information.
+ * 
+ * \return  A new RF channel to use.
+ */
+uint8_t unifying_state_channel_next(const struct unifying_state* state);
+
+/*!
+ * Take a snapshot of the link to a receiver.
+ * 
+ * The snapshot can be stored while the device sleeps and passed to unifying_state_link_restore()
+ * on wake so that unifying_connect() tries the channels that worked before.
+ * 
+ * \param[in]   state       Unifying state information.
+ * \param[out]  snapshot    Snapshot of the link.
+ */
+void unifying_state_link_snapshot(const struct unifying_state* state, struct unifying_link_snapshot* snapshot);
+
+/*!
+ * Restore a link snapshot taken by unifying_state_link_snapshot().
+ * 
+ * Sets the RF channel and keep-alive timeout, and replaces the quality of every channel.
+ * Success and failure counts are left unchanged.
+ * The idle timeout ladder continues from the first step that would raise the timeout further,
+ * and unifying_connect() keeps the restored timeout.
+ * This should be called after unifying_state_init() and unifying_state_idle_ladder_set(),
+ * and before unifying_connect().
+ * 
+ * \param[in,out]   state       Unifying state information.
+ * \param[in]       snapshot    Snapshot of the link.
+ * 
+ * \return  \ref UNIFYING_SET_CHANNEL_ERROR if the snapshot's channel isn't in \ref unifying_channels
+ *          or couldn't be set.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+enum unifying_error unifying_state_link_restore(struct unifying_state* state,
+                                                const struct unifying_link_snapshot* snapshot);
+
+/*!
+ * Pack the parts of a state that should survive a power cycle into a blob for non-volatile memory.
+ * 
+ * The blob holds the RF address, the AES key, and a snapshot from unifying_state_link_snapshot().
+ * It starts with \ref UNIFYING_STATE_BLOB_VERSION and ends with a checksum.
+ * The AES counter is stored separately by unifying_state_counter_lease_renew() since it changes far more often.
+ * 
+ * \param[in]   state   Unifying state information.
+ * \param[out]  blob    Byte array with space for at least \ref UNIFYING_STATE_BLOB_LEN bytes.
+ */
+void unifying_state_blob_pack(const struct unifying_state* state, uint8_t blob[UNIFYING_STATE_BLOB_LEN]);
+
+/*!
+ * Unpack a blob written by unifying_state_blob_pack().
+ * 
+ * \p address and \p aes_key can then be passed to unifying_state_init()
+ * and \p snapshot to unifying_state_link_restore().
+ * Nothing is unpacked if the blob isn't valid, such as when non-volatile memory has never been written.
+ * 
+ * \param[out]  address     Byte array with space for at least \ref UNIFYING_ADDRESS_LEN bytes.
+ * \param[out]  aes_key     Byte array with space for at least \ref UNIFYING_AES_BLOCK_LEN bytes.
+ * \param[out]  snapshot    Snapshot of the link.
+ * \param[in]   blob        Byte array with at least \ref UNIFYING_STATE_BLOB_LEN bytes.
+ * 
+ * \return  \ref UNIFYING_CHECKSUM_ERROR if the blob's checksum is wrong.
+ * \return  \ref UNIFYING_VERSION_ERROR if the blob isn't version \ref UNIFYING_STATE_BLOB_VERSION.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+enum unifying_error unifying_state_blob_unpack(uint8_t address[UNIFYING_ADDRESS_LEN],
+                                               uint8_t aes_key[UNIFYING_AES_BLOCK_LEN],
+                                               struct unifying_link_snapshot* snapshot,
+                                               const uint8_t blob[UNIFYING_STATE_BLOB_LEN]);
+
+/*!
+ * Resume the AES counter from counter lease slots read from non-volatile memory.
+ * 
+ * The counter is set to the end of the newest valid lease, which is past every counter value that could have
+ * been used before. The counter is then limited to that value, so unifying_state_counter_lease_renew() must be
+ * called before transmitting encrypted keystrokes.
+ * 
+ * If no slot is valid, such as when non-volatile memory has never been written,
+ * the counter passed to unifying_state_init() is kept but is still limited.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ * \param[in]       slots   Every counter lease slot.
+ * 
+ * \return  \ref UNIFYING_CHECKSUM_ERROR if no slot is valid.
+ * \return  \ref UNIFYING_SUCCESS otherwise.
+ */
+enum unifying_error unifying_state_counter_lease_load(struct unifying_state* state,
+                                                      const uint8_t slots[UNIFYING_COUNTER_LEASE_SLOTS]
+                                                                         [UNIFYING_COUNTER_LEASE_SLOT_LEN]);
+
+/*!
+ * Check if the AES counter lease should be renewed.
+ * 
+ * This is `true` once half of the current lease has been used,
+ * leaving time to write a new lease before encrypted keystrokes start failing.
+ * 
+ * \param[in]   state   Unifying state information.
+ * 
+ * \return  `true` if unifying_state_counter_lease_renew() should be called.
+ * \return  `false` otherwise, including when the counter isn't leased.
+ */
+bool unifying_state_counter_lease_due(const struct unifying_state* state);
+
+/*!
+ * Extend the AES counter lease by \ref UNIFYING_COUNTER_LEASE_LEN counter values.
+ * 
+ * The new lease is packed into \p slot, which must be written to non-volatile memory at the returned slot index
+ * before any more encrypted keystrokes are transmitted.
+ * Slots are used in turn so each one is written once every \ref UNIFYING_COUNTER_LEASE_SLOTS leases.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ * \param[out]      slot    Byte array with space for at least \ref UNIFYING_COUNTER_LEASE_SLOT_LEN bytes.
+ * 
+ * \return  Index of the slot that \p slot must be written to.
+ */
+uint8_t unifying_state_counter_lease_renew(struct unifying_state* state,
+                                           uint8_t slot[UNIFYING_COUNTER_LEASE_SLOT_LEN]);
+
 /*!
  * Set the RF address.
  * 
@@ -309,80 +1137,124 @@ uint8_t unifying_state_channel_set(struct unifying_state* state, uint8_t channel
 uint8_t unifying_state_address_set(struct unifying_state* state, const uint8_t address[UNIFYING_ADDRESS_LEN]);
 
 /*!
- * Initialize a \ref unifying_transmit_entry structure.
+ * Set the AES encryption key.
  * 
- * \param[out]  entry       Pointer to a \ref unifying_transmit_entry to initialize.
- * \param[in]   payload     Byte array of size `length`.
- * \param[in]   length      Size of `payload` in bytes.
- * \param[in]   timeout     A new timeout associated with `payload`.
+ * The key is copied into \ref unifying_state.aes_key "state.aes_key"
+ * and the cached \ref unifying_state.aes_context "state.aes_context" is invalidated.
  * 
- * \see unifying_transmit_entry
+ * \note    Callers that write to \ref unifying_state.aes_key "state.aes_key" directly
+ *          should call unifying_state_aes_key_changed() afterwards.
+ * 
+ * \param[in,out]   state       Unifying state information.
+ * \param[in]       aes_key     New AES-128 encryption key.
  */
-void unifying_transmit_entry_init(struct unifying_transmit_entry* entry,
-                                  uint8_t* payload,
-                                  uint8_t length,
-                                  uint8_t timeout);
+void unifying_state_aes_key_set(struct unifying_state* state, const uint8_t aes_key[UNIFYING_AES_BLOCK_LEN]);
+
+/*!
+ * Invalidate the cached \ref unifying_state.aes_context "state.aes_context".
+ * 
+ * The context will be prepared again from \ref unifying_state.aes_key "state.aes_key" before the next encryption.
+ * Any precomputed keystream is discarded as well.
+ * 
+ * \param[in,out]   state   Unifying state information.
+ */
+void unifying_state_aes_key_changed(struct unifying_state* state);
 
 /*!
- * Create and initialize a \ref unifying_transmit_entry structure.
+ * AES-128 encrypt data with \ref unifying_state.aes_key "state.aes_key".
  * 
- * \param[in]   length      Size in bytes of a buffer to allocate.
- * \param[in]   timeout     A new timeout to be associated with a payload.
+ * If the interface provides \ref unifying_interface.prepare_key "prepare_key" and
+ * \ref unifying_interface.encrypt_prepared "encrypt_prepared" then the cached
+ * \ref unifying_state.aes_context "state.aes_context" is used, preparing it first if necessary.
+ * Otherwise \ref unifying_interface.encrypt "encrypt" is used.
  * 
- * \return  `NULL` if allocation fails.
- * \return  Pointer to new \ref unifying_transmit_entry instance otherwise.
+ * \param[in,out]   state   Unifying state information.
+ * \param[in,out]   data    \ref UNIFYING_AES_DATA_LEN bytes of data to encrypt in place.
+ * \param[in]       iv      AES-128 initialization vector.
  * 
- * \see unifying_transmit_entry
- * \see unifying_transmit_entry_destroy()
+ * \return  `0` if successful.
+ * \return  Anything else on failure.
  */
-struct unifying_transmit_entry* unifying_transmit_entry_create(uint8_t length, uint8_t timeout);
+uint8_t unifying_state_encrypt(struct unifying_state* state,
+                               uint8_t data[UNIFYING_AES_DATA_LEN],
+                               const uint8_t iv[UNIFYING_AES_BLOCK_LEN]);
 
 /*!
- * Free a \ref unifying_transmit_entry instance.
+ * Precompute a keystream block for an upcoming AES counter value.
  * 
- * \param[in,out]   entry   Pointer to a \ref unifying_transmit_entry to free.
+ * Keystream blocks that belong to counter values older than
+ * \ref unifying_state.aes_counter "state.aes_counter" are discarded first.
+ * At most one block is computed per call so that the time spent in this function stays bounded.
  * 
- * \see unifying_transmit_entry
- * \see unifying_transmit_entry_create()
+ * \param[in,out]   state   Unifying state information.
+ * 
+ * \return  `0` if a block was computed or if no more blocks can be stored.
+ * \return  Anything else if encryption failed.
  */
-void unifying_transmit_entry_destroy(struct unifying_transmit_entry* entry);
+uint8_t unifying_state_keystream_fill(struct unifying_state* state);
 
 /*!
- * Initialize a \ref unifying_receive_entry structure.
+ * Encrypt keystroke data for \ref unifying_state.aes_counter "state.aes_counter".
  * 
- * \param[out]  entry       Pointer to a \ref unifying_receive_entry to initialize.
- * \param[in]   payload     Byte array of size `length`.
- * \param[in]   length      Size of `payload` in bytes.
+ * A precomputed keystream block is used if one is available.
+ * Otherwise the keystream is computed with unifying_state_encrypt().
+ * The keystream block is not consumed until \ref unifying_state.aes_counter "state.aes_counter" is incremented.
  * 
- * \see unifying_receive_entry
+ * \param[in,out]   state   Unifying state information.
+ * \param[in,out]   data    \ref UNIFYING_AES_DATA_LEN bytes of data to encrypt in place.
+ * 
+ * \return  `0` if successful.
+ * \return  Anything else on failure.
+ * 
+ * \see unifying_state_keystream_fill()
  */
-void unifying_receive_entry_init(struct unifying_receive_entry* entry,
-                                         uint8_t* payload,
-                                         uint8_t length);
+uint8_t unifying_state_keystroke_encrypt(struct unifying_state* state, uint8_t data[UNIFYING_AES_DATA_LEN]);
 
 /*!
- * Create and initialize a \ref unifying_receive_entry structure.
+ * Encrypt keystroke data for several states at once.
  * 
- * \param[in]   length      Size in bytes of a buffer to allocate.
+ * This is equivalent to calling unifying_state_keystroke_encrypt() for each state
+ * but states that need AES encryption and share an
+ * \ref unifying_interface.encrypt_prepared_batch "encrypt_prepared_batch" implementation
+ * are encrypted together, up to \ref UNIFYING_ENCRYPT_BATCH_LEN at a time.
+ * States with precomputed keystream don't need AES encryption at all.
  * 
- * \return  `NULL` if allocation fails.
- * \return  Pointer to new \ref unifying_receive_entry instance otherwise.
+ * \param[in,out]   states  \p count pointers to Unifying state information.
+ * \param[in,out]   data    \p count buffers of \ref UNIFYING_AES_DATA_LEN bytes to encrypt in place.
+ *                          `data[i]` is encrypted for `states[i]`.
+ * \param[in]       count   Number of states.
  * 
- * \see unifying_receive_entry
- * \see unifying_receive_entry_destroy()
+ * \return  `0` if every encryption succeeded.
+ * \return  Anything else if any encryption failed.
+ * 
+ * \see unifying_state_keystroke_encrypt()
+ */
+uint8_t unifying_state_keystroke_encrypt_batch(struct unifying_state* const states[],
+                                               uint8_t data[][UNIFYING_AES_DATA_LEN],
+                                               size_t count);
+
+/*!
+ * Initialize a \ref unifying_transmit_entry structure.
+ * 
+ * \param[out]  entry       Pointer to a \ref unifying_transmit_entry to initialize.
+ * \param[in]   length      Number of payload bytes that will be transmitted.
+ * \param[in]   timeout     A new timeout associated with the payload.
+ * 
+ * \see unifying_transmit_entry
  */
-struct unifying_receive_entry* unifying_receive_entry_create(uint8_t length);
+void unifying_transmit_entry_init(struct unifying_transmit_entry* entry,
+                                  uint8_t length,
+                                  uint16_t timeout);
 
 /*!
- * Free a \ref unifying_receive_entry instance.
+ * Initialize a \ref unifying_receive_entry structure.
  * 
- * \param[in,out]   entry   Pointer to a \ref unifying_receive_entry to free.
+ * \param[out]  entry       Pointer to a \ref unifying_receive_entry to initialize.
+ * \param[in]   length      Number of payload bytes that will be received.
  * 
  * \see unifying_receive_entry
- * \see unifying_receive_entry_create()
  */
-void unifying_receive_entry_destroy(struct unifying_receive_entry* entry);
-
+void unifying_receive_entry_init(struct unifying_receive_entry* entry, uint8_t length);
 
 #ifdef __cplusplus
 }
@@ -48,6 +48,22 @@ int16_t unifying_int12_clamp(int16_t number)
     return number;
 }
 
+uint32_t unifying_timeout_interval(uint16_t timeout)
+{
+    // timeout * UNIFYING_TIMEOUT_FRACTION fits in 32 bits.
+    // Scale the whole and fractional milliseconds separately so that the tick conversion can't overflow either.
+    uint32_t scaled = (uint32_t)timeout * UNIFYING_TIMEOUT_FRACTION;
+    uint32_t whole = (scaled >> 8) * UNIFYING_TIME_TICKS_PER_MS;
+    uint32_t fraction = ((scaled & 0xFF) * UNIFYING_TIME_TICKS_PER_MS) >> 8;
+
+    return whole + fraction;
+}
+
+bool unifying_time_reached(uint32_t time, uint32_t deadline)
+{
+    return (int32_t)(time - deadline) >= 0;
+}
+
 uint8_t unifying_checksum(const uint8_t* buffer, uint8_t length)
 {
     uint8_t checksum = 0;
@@ -135,6 +151,19 @@ void unifying_deobfuscate_aes_key(uint8_t aes_key[UNIFYING_AES_BLOCK_LEN],
     }
 }
 
+uint8_t unifying_channel_index(uint8_t channel)
+{
+    // Unifying channels are evenly spaced.
+    uint8_t index = (channel - unifying_channels[0]) / 3;
+
+    if(channel < unifying_channels[0] || index >= UNIFYING_CHANNELS_LEN || unifying_channels[index] != channel)
+    {
+        return UNIFYING_CHANNELS_LEN;
+    }
+
+    return index;
+}
+
 uint8_t unifying_next_channel(uint8_t channel)
 {
     // Convert the supplied channel into an index into an array of valid channels.
@@ -7,6 +7,7 @@
 #ifndef UNIFYING_UTILS_H
 #define UNIFYING_UTILS_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -120,6 +121,33 @@ void unifying_uint32_unpack(uint32_t* number, const uint8_t packed[4]);
  */
 int16_t unifying_int12_clamp(int16_t number);
 
+/*!
+ * Compute how long to wait after a transmission before transmitting a keep-alive packet.
+ * 
+ * The interval is \ref UNIFYING_TIMEOUT_FRACTION of \p timeout using only integer math.
+ * 
+ * \param[in]   timeout     Packet timeout in milliseconds.
+ * 
+ * \return  Interval in \ref unifying_interface.time "time" units.
+ *          See \ref UNIFYING_TIME_TICKS_PER_MS.
+ */
+uint32_t unifying_timeout_interval(uint16_t timeout);
+
+/*!
+ * Check if a deadline has been reached.
+ * 
+ * Times are compared by their signed difference so the result is correct even if
+ * either time has wrapped around past `UINT32_MAX`,
+ * as long as the two times are less than `2^31` units apart.
+ * 
+ * \param[in]   time        Current time.
+ * \param[in]   deadline    Time to compare against.
+ * 
+ * \return  `true` if \p time is at or after \p deadline.
+ * \return  `false` otherwise.
+ */
+bool unifying_time_reached(uint32_t time, uint32_t deadline);
+
 /*!
  * Compute the checksum of a byte array.
  * 
@@ -244,6 +272,16 @@ void unifying_proto_aes_key_pack(uint8_t packed[UNIFYING_AES_BLOCK_LEN],
 void unifying_deobfuscate_aes_key(uint8_t aes_key[UNIFYING_AES_BLOCK_LEN],
                                   const uint8_t proto_aes_key[UNIFYING_AES_BLOCK_LEN]);
 
+/*!
+ * Find an RF channel's position in \ref unifying_channels.
+ * 
+ * \param[in]   channel     RF channel to find.
+ * 
+ * \return  Index of \p channel in \ref unifying_channels.
+ * \return  \ref UNIFYING_CHANNELS_LEN if \p channel isn't a Unifying channel.
+ */
+uint8_t unifying_channel_index(uint8_t channel);
+
 /*!
  * Compute the next RF channel to use if a transmission fails.
  * 